@@ -0,0 +1,589 @@
+#include "structre/inertia_transform.hpp"
+#include "structre/particle_collision.hpp"
+#include "structre/particle_force.hpp"
+#include "structre/particle_integrator.hpp"
+#include "structre/particle_links.hpp"
+#include "structre/particle_pairwise.hpp"
+#include "structre/particle_spring.hpp"
+#include "structre/particle_world.hpp"
+#include "structre/pcontacts.hpp"
+#include "structre/rigid_body_store.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <my.h>
+#include <new>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Every allocation made through operator new or new[] is counted, so
+ * the benchmark can report how many allocations a step makes. Every
+ * form of operator delete frees through release, which is kept out
+ * of line so that the compiler does not pair free() with operator new
+ * where it inlines a delete expression.
+ */
+static std::atomic<unsigned long> allocations{0};
+
+[[gnu::noinline]] static void release(void* p) noexcept
+{
+    std::free(p);
+}
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    release(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    release(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    release(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    release(p);
+}
+
+static my::Vector3 scaledGravity(my::real scale)
+{
+    auto g = my::GRAVITY;
+    return g * scale;
+}
+
+/**
+ * Adds count particles on a cubic lattice with the given spacing,
+ * starting at the given height.
+ */
+static std::vector<my::ParticleHandle> addLattice(my::ParticleWorld &world, unsigned count, my::real spacing, my::real height)
+{
+    unsigned side = (unsigned)std::ceil(std::cbrt((double)count));
+    std::vector<my::ParticleHandle> handles;
+    handles.reserve(count);
+    for (unsigned i = 0; i < count; i++) {
+        my::Particle particle;
+        particle.setPosition(spacing * (i % side), height + spacing * (i / side % side), spacing * (i / side / side));
+        particle.setVelocity(my::real(i % 3) * 0.1f, 0, my::real(i % 5) * 0.1f);
+        particle.setDamping(0.99f);
+        particle.setMass(1.0f + (i % 7));
+        handles.push_back(world.addParticle(particle));
+    }
+    return handles;
+}
+
+static void setupFreeFall(my::ParticleWorld &world, unsigned count)
+{
+    auto handles = addLattice(world, count, 1.0f, 100.0f);
+    auto store = world.getParticles();
+    for (auto handle : handles) store->setAcceleration(handle, my::GRAVITY);
+}
+
+static void setupGravityDrag(my::ParticleWorld &world, unsigned count)
+{
+    auto handles = addLattice(world, count, 1.0f, 100.0f);
+    auto gravity = std::make_shared<my::ParticleGravity>(my::GRAVITY);
+    auto drag = std::make_shared<my::ParticleDrag>(0.1f, 0.01f);
+    for (auto handle : handles) {
+        world.getForceRegistry()->addRegistration(handle, gravity);
+        world.getForceRegistry()->addRegistration(handle, drag);
+    }
+}
+
+static void setupGroundContacts(my::ParticleWorld &world, unsigned count)
+{
+    auto handles = addLattice(world, count, 0.5f, -0.25f);
+    auto store = world.getParticles();
+    for (auto handle : handles) store->setAcceleration(handle, my::GRAVITY);
+
+    auto ground = std::make_shared<my::GroundContacts>();
+    ground->init(handles);
+    world.getContactGenerators()->push_back(ground);
+    world.setResolverMode(my::ParticleContactResolver::PRIORITY_QUEUE);
+}
+
+/**
+ * A square sheet hanging from its top row, with a spring along every
+ * edge of the grid. Each spring is registered at both of its ends.
+ */
+static void setupSpringMesh(my::ParticleWorld &world, unsigned count)
+{
+    unsigned side = (unsigned)std::ceil(std::sqrt((double)count));
+    std::vector<my::ParticleHandle> handles;
+    for (unsigned i = 0; i < count; i++) {
+        my::Particle particle;
+        particle.setPosition(my::real(i % side), 100.0f - my::real(i / side), 0);
+        particle.setAcceleration(i < side ? my::Vector3() : my::GRAVITY);
+        particle.setDamping(0.9f);
+        particle.setMass(1.0f);
+        if (i < side) particle.setInverseMass(0);
+        handles.push_back(world.addParticle(particle));
+    }
+
+    auto registry = world.getForceRegistry();
+    auto connect = [&](unsigned a, unsigned b) {
+        registry->addRegistration(handles[a], std::make_shared<my::ParticleSpring>(handles[b], 50.0f, 1.0f));
+        registry->addRegistration(handles[b], std::make_shared<my::ParticleSpring>(handles[a], 50.0f, 1.0f));
+    };
+    for (unsigned i = 0; i < count; i++) {
+        if (i % side + 1 < side && i + 1 < count) connect(i, i + 1);
+        if (i + side < count) connect(i, i + side);
+    }
+}
+
+/**
+ * The sheet of setupSpringMesh, with its springs held in one
+ * SpringNetwork and each particle registered once.
+ */
+static void setupSpringNetwork(my::ParticleWorld &world, unsigned count)
+{
+    unsigned side = (unsigned)std::ceil(std::sqrt((double)count));
+    std::vector<my::ParticleHandle> handles;
+    for (unsigned i = 0; i < count; i++) {
+        my::Particle particle;
+        particle.setPosition(my::real(i % side), 100.0f - my::real(i / side), 0);
+        particle.setAcceleration(i < side ? my::Vector3() : my::GRAVITY);
+        particle.setDamping(0.9f);
+        particle.setMass(1.0f);
+        if (i < side) particle.setInverseMass(0);
+        handles.push_back(world.addParticle(particle));
+    }
+
+    auto network = std::make_shared<my::SpringNetwork>();
+    network->reserve(2 * (std::size_t)count);
+    for (unsigned i = 0; i < count; i++) {
+        if (i % side + 1 < side && i + 1 < count) network->addSpring(handles[i], handles[i + 1], 50.0f, 1.0f);
+        if (i + side < count) network->addSpring(handles[i], handles[i + side], 50.0f, 1.0f);
+    }
+    for (auto handle : handles) world.getForceRegistry()->addRegistration(handle, network);
+}
+
+/**
+ * Chains of 8 particles hanging from a fixed first particle, joined
+ * alternately by cables and rods.
+ */
+static void setupChains(my::ParticleWorld &world, unsigned count)
+{
+    const unsigned length = 8;
+    auto links = std::make_shared<my::ParticleLinkRegistry>();
+    std::vector<my::ParticleHandle> handles;
+    for (unsigned i = 0; i < count; i++) {
+        my::Particle particle;
+        particle.setPosition(my::real(i / length) * 2.0f + my::real(i % length) * 0.5f, 100.0f, 0);
+        particle.setAcceleration(i % length == 0 ? my::Vector3() : my::GRAVITY);
+        particle.setDamping(0.99f);
+        particle.setMass(1.0f);
+        if (i % length == 0) particle.setInverseMass(0);
+        handles.push_back(world.addParticle(particle));
+
+        if (i % length == 0) continue;
+        if (i % 2) links->addCable(handles[i - 1], handles[i], 0.6f, 0.3f);
+        else links->addRod(handles[i - 1], handles[i], 0.5f);
+    }
+    world.getContactGenerators()->push_back(links);
+    world.setResolverMode(my::ParticleContactResolver::PRIORITY_QUEUE);
+}
+
+/**
+ * A slab of blob particles pulled together by the cohesion kernel and
+ * resting on the ground, with the constants of the blob demo.
+ */
+static void setupBlobCohesion(my::ParticleWorld &world, unsigned count)
+{
+    const my::real radius = 0.4f;
+    auto handles = addLattice(world, count, radius * 1.2f, 0.1f);
+    auto store = world.getParticles();
+    for (auto handle : handles) {
+        store->setAcceleration(handle, scaledGravity(0.4f));
+        store->setDamping(handle, 0.2f);
+    }
+
+    my::CohesionKernel kernel;
+    kernel.minNaturalDistance = radius * 0.75f;
+    kernel.maxNaturalDistance = radius * 1.5f;
+    kernel.maxDistance = radius * 2.5f;
+    kernel.maxRepulsion = 10.0f;
+    kernel.maxAttraction = 20.0f;
+    auto cohesion = std::make_shared<my::PairwiseForceGenerator<my::CohesionKernel>>(kernel.maxDistance, radius * 0.5f, kernel);
+    for (auto handle : handles) world.getForceRegistry()->addRegistration(handle, cohesion);
+
+    auto ground = std::make_shared<my::GroundContacts>();
+    ground->init(handles);
+    world.getContactGenerators()->push_back(ground);
+    world.setResolverMode(my::ParticleContactResolver::PRIORITY_QUEUE);
+}
+
+/**
+ * Particles scattered at random, about one per grid cell, colliding
+ * as spheres.
+ */
+static void setupCollisions(my::ParticleWorld &world, unsigned count)
+{
+    my::Random r(1);
+    unsigned side = (unsigned)std::cbrt((double)count) * 1024;
+    for (unsigned i = 0; i < count; i++) {
+        my::Particle particle;
+        particle.setPosition(my::real(r.randomInt(side)) / 1024,
+                             my::real(r.randomInt(side)) / 1024,
+                             my::real(r.randomInt(side)) / 1024);
+        particle.setDamping(0.99f);
+        particle.setMass(1.0f);
+        world.addParticle(particle);
+    }
+    world.getContactGenerators()->push_back(std::make_shared<my::ParticleCollisionGenerator>(0.25f));
+    world.setResolverMode(my::ParticleContactResolver::PRIORITY_QUEUE);
+}
+
+/**
+ * The ground contacts workload with resting particles put to sleep.
+ */
+static void setupGroundSleep(my::ParticleWorld &world, unsigned count)
+{
+    setupGroundContacts(world, count);
+    world.setSleepThreshold(0.3f);
+}
+
+/**
+ * The chains and collisions workloads with each contact island
+ * resolved on its own.
+ */
+static void setupChainIslands(my::ParticleWorld &world, unsigned count)
+{
+    setupChains(world, count);
+    world.setIslandResolution(true);
+}
+
+static void setupCollisionIslands(my::ParticleWorld &world, unsigned count)
+{
+    setupCollisions(world, count);
+    world.setIslandResolution(true);
+}
+
+/**
+ * The chains of setupChains, with their cables and rods projected as
+ * distance constraints instead of resolved as contacts.
+ */
+static void setupChainsPBD(my::ParticleWorld &world, unsigned count)
+{
+    const unsigned length = 8;
+    auto solver = std::make_shared<my::DistanceConstraintSolver>(4);
+    std::vector<my::ParticleHandle> handles;
+    for (unsigned i = 0; i < count; i++) {
+        my::Particle particle;
+        particle.setPosition(my::real(i / length) * 2.0f + my::real(i % length) * 0.5f, 100.0f, 0);
+        particle.setAcceleration(i % length == 0 ? my::Vector3() : my::GRAVITY);
+        particle.setDamping(0.99f);
+        particle.setMass(1.0f);
+        if (i % length == 0) particle.setInverseMass(0);
+        handles.push_back(world.addParticle(particle));
+
+        if (i % length == 0) continue;
+        if (i % 2) solver->addCable(handles[i - 1], handles[i], 0.6f);
+        else solver->addRod(handles[i - 1], handles[i], 0.5f);
+    }
+    world.setConstraintSolver(solver);
+}
+
+struct Workload
+{
+    const char* name;
+    void (*setup)(my::ParticleWorld &world, unsigned count);
+    my::ParticleIntegrator::Mode mode;
+    // Also run at a million particles when no --scale is given.
+    bool million = false;
+};
+
+static const Workload workloads[] = {
+    {"free_fall", setupFreeFall, my::ParticleIntegrator::SCALAR, true},
+    {"free_fall", setupFreeFall, my::ParticleIntegrator::SSE, true},
+    {"free_fall", setupFreeFall, my::ParticleIntegrator::AVX2, true},
+    {"gravity_drag", setupGravityDrag, my::ParticleIntegrator::BEST},
+    {"ground_contacts", setupGroundContacts, my::ParticleIntegrator::BEST},
+    {"ground_sleep", setupGroundSleep, my::ParticleIntegrator::BEST},
+    {"spring_mesh", setupSpringMesh, my::ParticleIntegrator::BEST},
+    {"spring_network", setupSpringNetwork, my::ParticleIntegrator::BEST},
+    {"chains", setupChains, my::ParticleIntegrator::BEST},
+    {"blob_cohesion", setupBlobCohesion, my::ParticleIntegrator::BEST},
+    {"collisions", setupCollisions, my::ParticleIntegrator::BEST, true},
+    {"chain_islands", setupChainIslands, my::ParticleIntegrator::BEST},
+    {"chains_pbd", setupChainsPBD, my::ParticleIntegrator::BEST},
+    {"collision_islands", setupCollisionIslands, my::ParticleIntegrator::BEST},
+};
+
+static const char* modeName(my::ParticleIntegrator::Mode mode)
+{
+    switch (my::ParticleIntegrator::resolve(mode)) {
+    case my::ParticleIntegrator::SSE: return "sse";
+    case my::ParticleIntegrator::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+struct Result
+{
+    unsigned steps;
+    double nsPerParticleStep;
+    double allocationsPerStep;
+    long peakRssKb;
+    bool finite;
+};
+
+/**
+ * When non-zero, the number of timed steps every run takes instead of
+ * scaling them to the workload size, as set by --steps.
+ */
+static unsigned fixedSteps = 0;
+
+static bool allFinite(const my::Vector3Array &vectors)
+{
+    for (std::size_t i = 0; i < vectors.size(); i++) {
+        if (!std::isfinite(vectors.x[i]) || !std::isfinite(vectors.y[i]) || !std::isfinite(vectors.z[i])) return false;
+    }
+    return true;
+}
+
+/**
+ * Builds the workload at the given scale and times enough fixed steps
+ * to cover about two million particle updates, after two untimed
+ * warm-up steps.
+ */
+static Result run(const Workload &workload, unsigned count)
+{
+    const my::real duration = 1.0f / 60.0f;
+    my::ParticleWorld world(count * 4);
+    world.setIntegratorMode(workload.mode);
+    workload.setup(world, count);
+
+    Result result;
+    result.steps = fixedSteps ? fixedSteps : 2000000 / count;
+    if (result.steps < 5) result.steps = 5;
+
+    for (unsigned i = 0; i < 2; i++) {
+        world.startFrame();
+        world.runPhysics(duration);
+    }
+
+    unsigned long allocationsBefore = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < result.steps; i++) {
+        world.startFrame();
+        world.runPhysics(duration);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    result.nsPerParticleStep = elapsed.count() / (double(count) * result.steps);
+    result.allocationsPerStep = double(allocations.load() - allocationsBefore) / result.steps;
+    result.finite = allFinite(world.getParticles()->positions()) && allFinite(world.getParticles()->velocities());
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peakRssKb = usage.ru_maxrss;
+    return result;
+}
+
+/**
+ * Kernels timed on their own rather than as part of a world step.
+ * Their records use the same columns, with the path in place of the
+ * integrator and bodies in place of particles.
+ */
+struct Kernel
+{
+    const char* name;
+    my::InertiaTensorTransform::Mode mode;
+};
+
+static const Kernel kernels[] = {
+    {"inertia_transform", my::InertiaTensorTransform::SCALAR},
+    {"inertia_transform", my::InertiaTensorTransform::SSE},
+    {"inertia_transform", my::InertiaTensorTransform::AVX},
+};
+
+static const char* modeName(my::InertiaTensorTransform::Mode mode)
+{
+    switch (my::InertiaTensorTransform::resolve(mode)) {
+    case my::InertiaTensorTransform::SSE: return "sse";
+    case my::InertiaTensorTransform::AVX: return "avx";
+    default: return "scalar";
+    }
+}
+
+/**
+ * Fills a store with boxes of varied sizes and orientations and times
+ * transforming all their inertia tensors into world space, as each
+ * rigid-body step does for the awake bodies.
+ */
+static Result run(const Kernel &kernel, unsigned count)
+{
+    my::RigidBodyStore bodies;
+    bodies.reserve(count);
+    for (unsigned i = 0; i < count; i++) {
+        my::RigidBody body;
+        body.setMass(1 + my::real(i % 7));
+        my::Matrix3 inertia;
+        inertia.setBlockInertiaTensor(my::Vector3(0.5f + 0.01f * (i % 13), 0.5f, 0.25f), body.getMass());
+        body.setInertiaTensor(inertia);
+        body.setOrientation(my::Quaternion(1, 0.01f * (i % 17), 0.3f, -0.02f * (i % 11)));
+        bodies.add(body);
+    }
+    my::InertiaTensorTransform transform(kernel.mode);
+
+    Result result;
+    result.steps = fixedSteps ? fixedSteps : 20000000 / count;
+    if (result.steps < 5) result.steps = 5;
+
+    for (unsigned i = 0; i < 2; i++) transform.transform(bodies, 0, count);
+
+    unsigned long allocationsBefore = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < result.steps; i++) transform.transform(bodies, 0, count);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    result.nsPerParticleStep = elapsed.count() / (double(count) * result.steps);
+    result.allocationsPerStep = double(allocations.load() - allocationsBefore) / result.steps;
+    result.finite = true;
+    for (const auto &component : bodies.inverseInertiaTensorsWorld().c) {
+        for (auto value : component) result.finite = result.finite && std::isfinite(value);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peakRssKb = usage.ru_maxrss;
+    return result;
+}
+
+static void print(bool json, bool first, const char* name, const char* mode, unsigned count, const Result &result)
+{
+    if (json) {
+        std::printf("%s\n  {\"workload\": \"%s\", \"integrator\": \"%s\", \"particles\": %u, \"steps\": %u, "
+                    "\"ns_per_particle_step\": %.3f, \"allocations_per_step\": %.2f, \"peak_rss_kb\": %ld}",
+                    first ? "" : ",", name, mode, count, result.steps,
+                    result.nsPerParticleStep, result.allocationsPerStep, result.peakRssKb);
+    } else {
+        std::printf("%s,%s,%u,%u,%.3f,%.2f,%ld\n", name, mode, count, result.steps,
+                    result.nsPerParticleStep, result.allocationsPerStep, result.peakRssKb);
+    }
+}
+
+static bool wanted(const std::vector<std::string> &only, const char* name)
+{
+    if (only.empty()) return true;
+    for (const auto &filter : only) {
+        if (filter == name) return true;
+    }
+    return false;
+}
+
+/**
+ * Runs one record in a forked child. Returns false if it failed,
+ * including when the simulation blew up to infinities or NaNs.
+ */
+template<class Task>
+static bool runForked(bool json, bool first, Task task, unsigned count)
+{
+    pid_t child = fork();
+    if (child == 0) {
+        Result result = run(task, count);
+        print(json, first, task.name, modeName(task.mode), count, result);
+        std::fflush(stdout);
+        _exit(result.finite ? 0 : 1);
+    }
+    int childStatus = 1;
+    if (child < 0 || waitpid(child, &childStatus, 0) < 0 || childStatus != 0) {
+        std::fprintf(stderr, "%s at %u particles failed\n", task.name, count);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Runs every workload at every scale and prints one record each:
+ *
+ *   bench [--json] [--scale N]... [--steps N] [workload]...
+ *
+ * Output is CSV unless --json is given. The default scales are 1000,
+ * 10000 and 100000 particles, plus 1000000 for the free-fall
+ * integrator and collisions runs; naming workloads runs only those.
+ * Particles per second are 1e9 / ns_per_particle_step. The
+ * standalone kernels run after the world workloads, at the default
+ * or given scales. --steps times that many steps of every run
+ * instead, for a quick check that every workload runs and stays
+ * finite.
+ *
+ * Each run happens in a forked child, so the peak RSS reported is that
+ * of the one workload rather than the high-water mark of all runs so
+ * far.
+ */
+int main(int argc, char** argv)
+{
+    bool json = false;
+    std::vector<unsigned> scales;
+    std::vector<std::string> only;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--json") == 0) json = true;
+        else if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc) scales.push_back((unsigned)std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc) fixedSteps = (unsigned)std::atoi(argv[++i]);
+        else only.push_back(argv[i]);
+    }
+    const bool defaultScales = scales.empty();
+    if (defaultScales) scales = {1000, 10000, 100000};
+
+    if (json) std::printf("[");
+    else std::printf("workload,integrator,particles,steps,ns_per_particle_step,allocations_per_step,peak_rss_kb\n");
+    std::fflush(stdout);
+
+    bool first = true;
+    int status = 0;
+    for (const auto &workload : workloads) {
+        if (!wanted(only, workload.name)) continue;
+        if (!my::ParticleIntegrator::supports(workload.mode)) continue;
+
+        auto counts = scales;
+        if (defaultScales && workload.million) counts.push_back(1000000);
+        for (auto count : counts) {
+            if (count == 0) continue;
+            if (!runForked(json, first, workload, count)) {
+                status = 1;
+                continue;
+            }
+            first = false;
+        }
+    }
+    for (const auto &kernel : kernels) {
+        if (!wanted(only, kernel.name)) continue;
+        if (!my::InertiaTensorTransform::supports(kernel.mode)) continue;
+
+        for (auto count : scales) {
+            if (count == 0) continue;
+            if (!runForked(json, first, kernel, count)) {
+                status = 1;
+                continue;
+            }
+            first = false;
+        }
+    }
+    if (json) std::printf("\n]\n");
+    return status;
+}
@@ -0,0 +1,175 @@
+#include "math/base.hpp"
+#include "math/vector3a.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <my.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Compares the packed Vector3 with the padded, SSE-backed Vector3A on
+ * the two paths that work on arrays of whole vectors: integrating
+ * particles held as structures, and resolving contacts between them.
+ * Both kernels follow Particle::integrate and ParticleContact, written
+ * once as templates over the vector type.
+ */
+template<class V>
+struct Body
+{
+    V position;
+    V velocity;
+    V acceleration;
+    V forceAccum;
+    my::real inverseMass;
+    my::real damping;
+};
+
+template<class V>
+struct Contact
+{
+    unsigned body[2];
+    V contactNormal;
+    my::real restitution;
+    my::real penetration;
+};
+
+template<class V>
+static void integrate(std::vector<Body<V>> &bodies, my::real duration)
+{
+    for (auto &body : bodies) {
+        body.position.addScaledVector(body.velocity, duration);
+        V resultingAcc = body.acceleration;
+        resultingAcc.addScaledVector(body.forceAccum, body.inverseMass);
+        body.velocity.addScaledVector(resultingAcc, duration);
+        body.velocity *= body.damping;
+        body.forceAccum.clear();
+    }
+}
+
+template<class V>
+static void resolve(std::vector<Body<V>> &bodies, const std::vector<Contact<V>> &contacts)
+{
+    for (const auto &contact : contacts) {
+        Body<V> &a = bodies[contact.body[0]];
+        Body<V> &b = bodies[contact.body[1]];
+        my::real totalInverseMass = a.inverseMass + b.inverseMass;
+
+        my::real separatingVelocity = (a.velocity - b.velocity) * contact.contactNormal;
+        if (separatingVelocity < 0) {
+            my::real deltaVelocity = -separatingVelocity * (1 + contact.restitution);
+            V impulsePerIMass = contact.contactNormal * (deltaVelocity / totalInverseMass);
+            a.velocity.addScaledVector(impulsePerIMass, a.inverseMass);
+            b.velocity.addScaledVector(impulsePerIMass, -b.inverseMass);
+        }
+
+        if (contact.penetration > 0) {
+            V movePerIMass = contact.contactNormal * (contact.penetration / totalInverseMass);
+            a.position.addScaledVector(movePerIMass, a.inverseMass);
+            b.position.addScaledVector(movePerIMass, -b.inverseMass);
+        }
+    }
+}
+
+template<class V>
+static std::vector<Body<V>> makeBodies(unsigned count)
+{
+    std::vector<Body<V>> bodies(count);
+    for (unsigned i = 0; i < count; i++) {
+        bodies[i].position = V(my::real(i % 97), my::real(i % 89), my::real(i % 83));
+        bodies[i].velocity = V(1, my::real(i % 7) - 3, 0.5f);
+        bodies[i].acceleration = V(0, -9.81f, 0);
+        bodies[i].forceAccum = V(0.1f, 0, -0.1f);
+        bodies[i].inverseMass = 1.0f / (1 + i % 5);
+        bodies[i].damping = 0.999f;
+    }
+    return bodies;
+}
+
+template<class V>
+static std::vector<Contact<V>> makeContacts(unsigned count)
+{
+    std::vector<Contact<V>> contacts(count);
+    for (unsigned i = 0; i < count; i++) {
+        V normal(my::real(i % 3) - 1, 1, my::real(i % 5) * 0.25f);
+        normal.normalize();
+        contacts[i].body[0] = i;
+        contacts[i].body[1] = (i * 7919u + 1) % count;
+        contacts[i].contactNormal = normal;
+        contacts[i].restitution = 0.5f;
+        contacts[i].penetration = 0.01f;
+    }
+    return contacts;
+}
+
+/**
+ * Times enough passes of the kernel to cover about twenty million
+ * vector updates and returns nanoseconds per body or contact.
+ */
+template<class V>
+static double timeKernel(const char* kernel, unsigned count, unsigned &passes)
+{
+    std::vector<Body<V>> bodies = makeBodies<V>(count);
+    std::vector<Contact<V>> contacts = makeContacts<V>(count);
+    const bool integrating = std::strcmp(kernel, "integrate") == 0;
+    passes = 20000000 / count;
+    if (passes < 5) passes = 5;
+
+    auto pass = [&]() {
+        if (integrating) integrate(bodies, 1.0f / 60);
+        else resolve(bodies, contacts);
+    };
+    pass();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < passes; i++) pass();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    // Keep the results live so the passes are not optimised away.
+    volatile my::real sink = bodies[count / 2].position.x;
+    (void)sink;
+    return elapsed.count() / (double(count) * passes);
+}
+
+/**
+ * Prints one CSV record per kernel, layout and scale:
+ *
+ *   vector_bench [--scale N]... [kernel]...
+ *
+ * The kernels are integrate and contacts. The default scales are 1000,
+ * 10000 and 100000 items.
+ */
+int main(int argc, char** argv)
+{
+    std::vector<unsigned> scales;
+    std::vector<std::string> only;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc) scales.push_back((unsigned)std::atoi(argv[++i]));
+        else only.push_back(argv[i]);
+    }
+    if (scales.empty()) scales = {1000, 10000, 100000};
+
+    // With MY_ALIGNED_VECTOR both rows measure Vector3A.
+    const char* packed = std::is_same<my::Vector3, my::Vector3A>::value ? "aligned" : "packed";
+
+    std::printf("kernel,layout,items,passes,ns_per_item\n");
+    const char* kernels[] = {"integrate", "contacts"};
+    for (const char* kernel : kernels) {
+        if (!only.empty()) {
+            bool wanted = false;
+            for (const auto &name : only) wanted |= (name == kernel);
+            if (!wanted) continue;
+        }
+        for (auto count : scales) {
+            if (count == 0) continue;
+            unsigned passes;
+            double ns = timeKernel<my::Vector3>(kernel, count, passes);
+            std::printf("%s,%s,%u,%u,%.3f\n", kernel, packed, count, passes, ns);
+            ns = timeKernel<my::Vector3A>(kernel, count, passes);
+            std::printf("%s,%s,%u,%u,%.3f\n", kernel, "aligned", count, passes, ns);
+            std::fflush(stdout);
+        }
+    }
+    return 0;
+}
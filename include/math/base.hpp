@@ -3,10 +3,19 @@
 
 #include <cmath>
 #include <cstddef>
+#include <type_traits>
 
 #include <math/precision.hpp>
+#include <math/vector3a.hpp>
 
 namespace my{
+#ifdef MY_ALIGNED_VECTOR
+    typedef Vector3A Vector3;
+#else
+    /**
+     * Three packed components. It is trivially copyable, so arrays
+     * of vectors can be copied with memcpy.
+     */
     class Vector3{
         public:
             real x;
@@ -14,11 +23,6 @@ namespace my{
             real z;
         public:
             Vector3(): x(0), y(0), z(0) {}
-            Vector3(const Vector3 &vector){
-                x = vector.x;
-                y = vector.y;
-                z = vector.z;
-            }
             Vector3(const real x , const real y, const real z) : x(x), y(y), z(z) {}
 
             void operator+=(const Vector3& v){
@@ -47,7 +51,7 @@ namespace my{
                 z *= value;
             }
 
-            Vector3 operator*(const real value){
+            Vector3 operator*(const real value) const{
                 return Vector3(x*value, y*value, z*value);
             }
 
@@ -131,6 +135,9 @@ namespace my{
                 }
             }
     };
+#endif
+
+    static_assert(std::is_trivially_copyable<Vector3>::value, "Vector3 must be trivially copyable");
 
     const Vector3 GRAVITY = Vector3(0, -9.81, 0);
     const Vector3 HIGH_GRAVITY = Vector3(0, -19.62, 0);
@@ -1,20 +1,54 @@
 #ifndef MY_MATH_PRECISON_H
 #define MY_MATH_PRECISON_H
 
-#include <float.h>
+#include <cmath>
+#include <limits>
+#include <type_traits>
 
 namespace my{
+    /**
+     * The engine computes in float unless MY_DOUBLE_PRECISION is
+     * defined, which the CMake option of the same name does.
+     */
+#ifdef MY_DOUBLE_PRECISION
+    typedef double real;
+#else
     typedef float real;
-    #define real_sqrt sqrtf
-    #define real_abs fabsf
-    #define real_sin sinf
-    #define real_cos cosf 
-    #define real_exp expf
-    #define real_pow powf
-    #define real_mod fmodf
-    #define real_epsilon FLT_EPSILON
-    #define REAL_MAX FLT_MAX
-    #define REAL_PI 3.14159f
+#endif
+
+    /**
+     * The math functions compute in T, which is real unless named
+     * explicitly, as in real_sqrt<double>(x). Arguments are converted
+     * to T rather than deducing it, so passing a double literal to a
+     * float build still computes in float.
+     */
+    template<class T>
+    using real_arg = typename std::enable_if<true, T>::type;
+
+    template<class T = real>
+    inline T real_sqrt(real_arg<T> value){ return std::sqrt(value); }
+
+    template<class T = real>
+    inline T real_abs(real_arg<T> value){ return std::fabs(value); }
+
+    template<class T = real>
+    inline T real_sin(real_arg<T> value){ return std::sin(value); }
+
+    template<class T = real>
+    inline T real_cos(real_arg<T> value){ return std::cos(value); }
+
+    template<class T = real>
+    inline T real_exp(real_arg<T> value){ return std::exp(value); }
+
+    template<class T = real>
+    inline T real_pow(real_arg<T> base, real_arg<T> exponent){ return std::pow(base, exponent); }
+
+    template<class T = real>
+    inline T real_mod(real_arg<T> value, real_arg<T> divisor){ return std::fmod(value, divisor); }
+
+    constexpr real real_epsilon = std::numeric_limits<real>::epsilon();
+    constexpr real REAL_MAX = std::numeric_limits<real>::max();
+    constexpr real REAL_PI = (real)3.14159265358979323846;
 }
 
-#endif
\ No newline at end of file
+#endif
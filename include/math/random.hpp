@@ -3,11 +3,17 @@
 
 #include "math/base.hpp"
 #include "math/precision.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <ctime>
-#include <random>
 
 
 namespace my{
+    /**
+     * A xoshiro128** pseudo-random number stream. Two streams created
+     * with the same non-zero seed produce the same sequence, and every
+     * number, whatever its type, is drawn from that one sequence.
+     */
     class Random{
     public:
     	/**
@@ -42,6 +48,12 @@ namespace my{
          */
         unsigned randomBits();
 
+        /**
+         * Returns a random 64 bit bitstring made of the next two
+         * bitstrings of the stream.
+         */
+        uint64_t randomBits64();
+
         /**
          * Returns a random floating point number between 0 and 1.
          */
@@ -96,6 +108,33 @@ namespace my{
          */
         Vector3 randomXZVector(real scale);
 
+        /**
+         * Fills the given array with random floating point numbers
+         * between 0 and 1. The values are the same as count calls to
+         * randomReal() would return.
+         */
+        void fillReal(real *values, std::size_t count);
+
+        /**
+         * Fills the given array with random floating point numbers
+         * between min and max.
+         */
+        void fillReal(real *values, std::size_t count, real min, real max);
+
+        /**
+         * Fills the given array with random vectors in the cube
+         * defined by the given minimum and maximum vectors, as
+         * count calls to randomVector(min, max) would.
+         */
+        void fillVector(Vector3 *vectors, std::size_t count, const Vector3 &min, const Vector3 &max);
+
+        /**
+         * Fills the given array with random vectors where each
+         * component is binomially distributed in the range (-scale to
+         * scale), as count calls to randomVector(scale) would.
+         */
+        void fillVector(Vector3 *vectors, std::size_t count, const Vector3 &scale);
+
         /**
          * Returns a random orientation (i.e. normalized) quaternion.
          */
@@ -103,8 +142,7 @@ namespace my{
 
     private:
         // Internal mechanics
-        int p1, p2;
-        unsigned buffer[17];
+        uint32_t state[4];
     };
 
 
@@ -124,16 +162,18 @@ inline void Random::seed(unsigned s)
         s = (unsigned)clock();
     }
 
-    // Fill the buffer with some basic random numbers
-    for (unsigned i = 0; i < 17; i++)
+    // Spread the seed over the whole state with splitmix64, which
+    // never gives an all-zero state.
+    uint64_t x = s;
+    for (unsigned i = 0; i < 4; i += 2)
     {
-        // Simple linear congruential generator
-        s = s * 2891336453 + 1;
-        buffer[i] = s;
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        state[i] = (uint32_t)z;
+        state[i + 1] = (uint32_t)(z >> 32);
     }
-
-    // Initialize pointers into the buffer
-    p1 = 0;  p2 = 10;
 }
 
 inline unsigned Random::rotl(unsigned n, unsigned r)
@@ -150,24 +190,33 @@ inline unsigned Random::rotr(unsigned n, unsigned r)
 
 inline unsigned Random::randomBits()
 {
-    unsigned result;
+    unsigned result = rotl(state[1] * 5, 7) * 9;
+    unsigned t = state[1] << 9;
 
-    // Rotate the buffer and store it back to itself
-    result = buffer[p1] = rotl(buffer[p2], 13) + rotl(buffer[p1], 9);
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 11);
 
-    // Rotate pointers
-    if (--p1 < 0) p1 = 16;
-    if (--p2 < 0) p2 = 16;
-
-    // Return result
     return result;
 }
 
+inline uint64_t Random::randomBits64()
+{
+    uint64_t high = randomBits();
+    return (high << 32) | randomBits();
+}
+
 inline real Random::randomReal()
 {
-    std::mt19937_64 eng{std::random_device{}()};
-    std::uniform_real_distribution<real> dis(0,1);
-    return dis(eng);
+    // Use as many bits as the mantissa holds, so every value is
+    // exactly representable and 1 is never returned.
+    if (sizeof(real) > sizeof(float)) {
+        return real(randomBits64() >> 11) * real(1.0 / 9007199254740992.0);
+    }
+    return real(randomBits() >> 8) * real(1.0 / 16777216.0);
 }
 
 inline real Random::randomReal(real min, real max)
@@ -182,7 +231,7 @@ inline real Random::randomReal(real scale)
 
 inline unsigned Random::randomInt(unsigned max)
 {
-    return randomBits() % max;
+    return (unsigned)(((uint64_t)randomBits() * max) >> 32);
 }
 
 inline real Random::randomBinomial(real scale)
@@ -240,6 +289,39 @@ inline Vector3 Random::randomVector(const Vector3 &min, const Vector3 &max)
         );
 }
 
+inline void Random::fillReal(real *values, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        values[i] = randomReal();
+    }
+}
+
+inline void Random::fillReal(real *values, std::size_t count, real min, real max)
+{
+    const real range = max - min;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        values[i] = randomReal() * range + min;
+    }
+}
+
+inline void Random::fillVector(Vector3 *vectors, std::size_t count, const Vector3 &min, const Vector3 &max)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        vectors[i] = randomVector(min, max);
+    }
+}
+
+inline void Random::fillVector(Vector3 *vectors, std::size_t count, const Vector3 &scale)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        vectors[i] = randomVector(scale);
+    }
+}
+
 }
 
 #endif
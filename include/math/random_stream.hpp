@@ -0,0 +1,394 @@
+#ifndef MY_MATH_RANDOM_STREAM_H
+#define MY_MATH_RANDOM_STREAM_H
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+#include "math/vector_array.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MY_RANDOM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace my{
+    /**
+     * A counter-based random number stream for filling large arrays at
+     * once, such as the particles of an emitter burst.
+     *
+     * Sample n of the stream is a hash of the seed and n alone, so the
+     * values do not depend on how the samples are split into calls or
+     * over threads: filling 50000 samples at once gives the same values
+     * as filling them 7 at a time, and a thread can fill its own range
+     * after seek(). Eight samples are generated at a time with AVX2
+     * when the CPU supports it. The vector and scalar paths give the
+     * same values unless the compiler contracts the scalar arithmetic
+     * into fused multiply-adds.
+     *
+     * Every fill advances the stream by the number of samples it
+     * wrote, whatever the kind of sample. Sample indices are 32 bits,
+     * so a stream repeats after 2^32 samples.
+     */
+    class RandomStream{
+    public:
+        RandomStream(unsigned seed = 1, uint32_t position = 0);
+
+        /**
+         * Moves the stream to the given sample index.
+         */
+        void seek(uint32_t position);
+
+        /**
+         * Returns the index of the next sample.
+         */
+        uint32_t tell() const;
+
+        /**
+         * Fills the given array with numbers uniformly distributed
+         * between min and max.
+         */
+        void fillUniform(real *values, std::size_t count, real min, real max);
+
+        /**
+         * Writes count vectors uniformly distributed in the box
+         * between min and max to the given array, starting at begin.
+         * The array must already hold begin + count vectors.
+         */
+        void fillUniform(Vector3Array &vectors, std::size_t begin, std::size_t count, const Vector3 &min, const Vector3 &max);
+
+        /**
+         * Writes count vectors with each component binomially
+         * distributed between -scale and +scale, as
+         * Random::randomVector(scale) gives them.
+         */
+        void fillBinomial(Vector3Array &vectors, std::size_t begin, std::size_t count, const Vector3 &scale);
+
+        /**
+         * Writes count vectors uniformly distributed over the surface
+         * of a sphere of the given radius.
+         */
+        void fillUnitSphere(Vector3Array &vectors, std::size_t begin, std::size_t count, real radius = 1);
+
+        /**
+         * Returns whether the vectorised path runs on this CPU.
+         */
+        static bool vectorised();
+
+    private:
+        enum{ KEYS = 6 };
+
+        // Each component of a sample is drawn from its own substream.
+        uint32_t keys[KEYS];
+        uint32_t position;
+
+        static uint32_t hash(uint32_t x);
+        static float toUnit(uint32_t bits);
+        static float sinHalfTurn(float angle);
+
+        void uniformLane(uint32_t n, const float *offset, const float *range, float *out) const;
+        void binomialLane(uint32_t n, const float *scale, float *out) const;
+        void sphereLane(uint32_t n, float radius, float *out) const;
+
+        enum Kind{ UNIFORM, BINOMIAL, SPHERE };
+        void fill(Kind kind, real *x, real *y, real *z, std::size_t count, const float *a, const float *b);
+
+#ifdef MY_RANDOM_X86
+        void fillAVX2(Kind kind, real *x, real *y, real *z, std::size_t count, const float *a, const float *b);
+        static __m256i hash8(__m256i x);
+        static __m256 toUnit8(__m256i bits);
+        static __m256 sinHalfTurn8(__m256 angle);
+        static void store8(float *target, __m256 values);
+        static void store8(double *target, __m256 values);
+#endif
+    };
+
+
+inline RandomStream::RandomStream(unsigned seed, uint32_t position) : position(position)
+{
+    for (unsigned k = 0; k < KEYS; k++)
+    {
+        keys[k] = hash(seed + 0x9E3779B9u * (k + 1));
+    }
+}
+
+inline void RandomStream::seek(uint32_t position)
+{
+    RandomStream::position = position;
+}
+
+inline uint32_t RandomStream::tell() const
+{
+    return position;
+}
+
+inline bool RandomStream::vectorised()
+{
+#ifdef MY_RANDOM_X86
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+/**
+ * The lowbias32 integer hash. Substream k gives sample n the bits
+ * hash(n * golden ratio + key[k]).
+ */
+inline uint32_t RandomStream::hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline float RandomStream::toUnit(uint32_t bits)
+{
+    return float(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * Sine of an angle in [-pi/2, pi/2], from its Taylor series to the
+ * eleventh power, which is accurate to float precision there.
+ */
+inline float RandomStream::sinHalfTurn(float angle)
+{
+    float a2 = angle * angle;
+    float p = a2 * (-1.0f / 39916800.0f) + (1.0f / 362880.0f);
+    p = a2 * p + (-1.0f / 5040.0f);
+    p = a2 * p + (1.0f / 120.0f);
+    p = a2 * p + (-1.0f / 6.0f);
+    p = a2 * p + 1.0f;
+    return angle * p;
+}
+
+inline void RandomStream::uniformLane(uint32_t n, const float *offset, const float *range, float *out) const
+{
+    const uint32_t base = n * 0x9E3779B9u;
+    for (unsigned c = 0; c < 3; c++)
+    {
+        out[c] = toUnit(hash(base + keys[c])) * range[c] + offset[c];
+    }
+}
+
+inline void RandomStream::binomialLane(uint32_t n, const float *scale, float *out) const
+{
+    const uint32_t base = n * 0x9E3779B9u;
+    for (unsigned c = 0; c < 3; c++)
+    {
+        float u = toUnit(hash(base + keys[c]));
+        float v = toUnit(hash(base + keys[c + 3]));
+        out[c] = (u - v) * scale[c];
+    }
+}
+
+/**
+ * Picks the height uniformly, which makes the area uniform on the
+ * sphere, and the angle around the axis uniformly in a half turn.
+ * The lowest bit of the angle's hash picks which half.
+ */
+inline void RandomStream::sphereLane(uint32_t n, float radius, float *out) const
+{
+    const uint32_t base = n * 0x9E3779B9u;
+    const uint32_t bits = hash(base + keys[1]);
+    float z = toUnit(hash(base + keys[0])) * 2.0f - 1.0f;
+    float ring = 1.0f - z * z;
+    ring = std::sqrt(ring > 0.0f ? ring : 0.0f) * radius;
+
+    float angle = (toUnit(bits) - 0.5f) * 3.14159265f;
+    float s = sinHalfTurn(angle);
+    float c = sinHalfTurn(1.57079633f - std::fabs(angle));
+    if (bits & 1) c = -c;
+
+    out[0] = ring * c;
+    out[1] = ring * s;
+    out[2] = z * radius;
+}
+
+inline void RandomStream::fill(Kind kind, real *x, real *y, real *z, std::size_t count, const float *a, const float *b)
+{
+#ifdef MY_RANDOM_X86
+    if (vectorised())
+    {
+        fillAVX2(kind, x, y, z, count, a, b);
+        return;
+    }
+#endif
+    float out[3];
+    for (std::size_t i = 0; i < count; i++, position++)
+    {
+        switch (kind)
+        {
+        case UNIFORM: uniformLane(position, a, b, out); break;
+        case BINOMIAL: binomialLane(position, a, out); break;
+        case SPHERE: sphereLane(position, a[0], out); break;
+        }
+        x[i] = out[0];
+        if (y) y[i] = out[1];
+        if (z) z[i] = out[2];
+    }
+}
+
+inline void RandomStream::fillUniform(real *values, std::size_t count, real min, real max)
+{
+    const float offset[3] = {float(min), 0, 0};
+    const float range[3] = {float(max - min), 0, 0};
+    fill(UNIFORM, values, nullptr, nullptr, count, offset, range);
+}
+
+inline void RandomStream::fillUniform(Vector3Array &vectors, std::size_t begin, std::size_t count, const Vector3 &min, const Vector3 &max)
+{
+    const float offset[3] = {float(min.x), float(min.y), float(min.z)};
+    const float range[3] = {float(max.x - min.x), float(max.y - min.y), float(max.z - min.z)};
+    fill(UNIFORM, vectors.x.data() + begin, vectors.y.data() + begin, vectors.z.data() + begin, count, offset, range);
+}
+
+inline void RandomStream::fillBinomial(Vector3Array &vectors, std::size_t begin, std::size_t count, const Vector3 &scale)
+{
+    const float s[3] = {float(scale.x), float(scale.y), float(scale.z)};
+    fill(BINOMIAL, vectors.x.data() + begin, vectors.y.data() + begin, vectors.z.data() + begin, count, s, nullptr);
+}
+
+inline void RandomStream::fillUnitSphere(Vector3Array &vectors, std::size_t begin, std::size_t count, real radius)
+{
+    const float r[3] = {float(radius), 0, 0};
+    fill(SPHERE, vectors.x.data() + begin, vectors.y.data() + begin, vectors.z.data() + begin, count, r, nullptr);
+}
+
+#ifdef MY_RANDOM_X86
+__attribute__((target("avx2")))
+inline __m256i RandomStream::hash8(__m256i x)
+{
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32(0x7FEB352D));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x846CA68Bu));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    return x;
+}
+
+__attribute__((target("avx2")))
+inline __m256 RandomStream::toUnit8(__m256i bits)
+{
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+}
+
+__attribute__((target("avx2")))
+inline __m256 RandomStream::sinHalfTurn8(__m256 angle)
+{
+    __m256 a2 = _mm256_mul_ps(angle, angle);
+    __m256 p = _mm256_add_ps(_mm256_mul_ps(a2, _mm256_set1_ps(-1.0f / 39916800.0f)), _mm256_set1_ps(1.0f / 362880.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(a2, p), _mm256_set1_ps(-1.0f / 5040.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(a2, p), _mm256_set1_ps(1.0f / 120.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(a2, p), _mm256_set1_ps(-1.0f / 6.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(a2, p), _mm256_set1_ps(1.0f));
+    return _mm256_mul_ps(angle, p);
+}
+
+__attribute__((target("avx2")))
+inline void RandomStream::store8(float *target, __m256 values)
+{
+    _mm256_storeu_ps(target, values);
+}
+
+__attribute__((target("avx2")))
+inline void RandomStream::store8(double *target, __m256 values)
+{
+    _mm256_storeu_pd(target, _mm256_cvtps_pd(_mm256_castps256_ps128(values)));
+    _mm256_storeu_pd(target + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(values, 1)));
+}
+
+/**
+ * The same arithmetic as the scalar lanes, eight samples at a time. A
+ * final partial batch is generated whole into a buffer and only the
+ * samples asked for are copied out.
+ */
+__attribute__((target("avx2")))
+inline void RandomStream::fillAVX2(Kind kind, real *x, real *y, real *z, std::size_t count, const float *a, const float *b)
+{
+    const __m256i golden = _mm256_set1_epi32((int)0x9E3779B9u);
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i key[KEYS];
+    for (unsigned k = 0; k < KEYS; k++)
+    {
+        key[k] = _mm256_set1_epi32((int)keys[k]);
+    }
+    real *targets[3] = {x, y, z};
+
+    for (std::size_t i = 0; i < count; i += 8)
+    {
+        const __m256i n = _mm256_add_epi32(_mm256_set1_epi32((int)(position + (uint32_t)i)), laneIndex);
+        const __m256i base = _mm256_mullo_epi32(n, golden);
+        __m256 out[3];
+
+        switch (kind)
+        {
+        case UNIFORM:
+            for (unsigned c = 0; c < 3; c++)
+            {
+                __m256 u = toUnit8(hash8(_mm256_add_epi32(base, key[c])));
+                out[c] = _mm256_add_ps(_mm256_mul_ps(u, _mm256_set1_ps(b[c])), _mm256_set1_ps(a[c]));
+            }
+            break;
+
+        case BINOMIAL:
+            for (unsigned c = 0; c < 3; c++)
+            {
+                __m256 u = toUnit8(hash8(_mm256_add_epi32(base, key[c])));
+                __m256 v = toUnit8(hash8(_mm256_add_epi32(base, key[c + 3])));
+                out[c] = _mm256_mul_ps(_mm256_sub_ps(u, v), _mm256_set1_ps(a[c]));
+            }
+            break;
+
+        case SPHERE:
+            {
+                const __m256 radius = _mm256_set1_ps(a[0]);
+                const __m256i bits = hash8(_mm256_add_epi32(base, key[1]));
+                __m256 height = toUnit8(hash8(_mm256_add_epi32(base, key[0])));
+                height = _mm256_sub_ps(_mm256_mul_ps(height, _mm256_set1_ps(2.0f)), _mm256_set1_ps(1.0f));
+                __m256 ring = _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(height, height));
+                ring = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_max_ps(ring, _mm256_setzero_ps())), radius);
+
+                __m256 angle = _mm256_mul_ps(_mm256_sub_ps(toUnit8(bits), _mm256_set1_ps(0.5f)), _mm256_set1_ps(3.14159265f));
+                __m256 absAngle = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), angle);
+                __m256 s = sinHalfTurn8(angle);
+                __m256 c = sinHalfTurn8(_mm256_sub_ps(_mm256_set1_ps(1.57079633f), absAngle));
+                c = _mm256_xor_ps(c, _mm256_castsi256_ps(_mm256_slli_epi32(bits, 31)));
+
+                out[0] = _mm256_mul_ps(ring, c);
+                out[1] = _mm256_mul_ps(ring, s);
+                out[2] = _mm256_mul_ps(height, radius);
+            }
+            break;
+        }
+
+        if (count - i >= 8)
+        {
+            for (unsigned c = 0; c < 3; c++)
+            {
+                if (targets[c]) store8(targets[c] + i, out[c]);
+            }
+            continue;
+        }
+        for (unsigned c = 0; c < 3; c++)
+        {
+            if (!targets[c]) continue;
+            real values[8];
+            store8(values, out[c]);
+            for (std::size_t l = 0; i + l < count; l++)
+            {
+                targets[c][i + l] = values[l];
+            }
+        }
+    }
+    position += (uint32_t)count;
+}
+#endif
+
+}
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef MY_MATH_VECTOR3A_H
+#define MY_MATH_VECTOR3A_H
+
+#include <cmath>
+#include <type_traits>
+
+#include <math/precision.hpp>
+
+#if defined(__SSE2__) && !defined(MY_DOUBLE_PRECISION)
+#define MY_VECTOR3A_SSE 1
+#include <immintrin.h>
+#endif
+
+namespace my{
+    /**
+     * A vector padded to four components and aligned to 16 bytes, so
+     * that each one fills exactly one SSE register. It has the same
+     * interface as Vector3, and the arithmetic runs on all four lanes
+     * at once where SSE2 is available. The padding component is kept
+     * at zero so that it never contributes to a dot product or
+     * magnitude.
+     *
+     * Defining MY_ALIGNED_VECTOR makes Vector3 itself an alias of this
+     * type, so the whole engine builds against it.
+     */
+    class alignas(16) Vector3A{
+        public:
+            union{
+                struct{
+                    real x;
+                    real y;
+                    real z;
+                    real pad;
+                };
+
+                real data[4];
+            };
+
+        public:
+            Vector3A(): x(0), y(0), z(0), pad(0) {}
+            Vector3A(const real x, const real y, const real z) : x(x), y(y), z(z), pad(0) {}
+
+#ifdef MY_VECTOR3A_SSE
+            explicit Vector3A(__m128 v){
+                _mm_store_ps(data, v);
+            }
+
+            __m128 simd() const{
+                return _mm_load_ps(data);
+            }
+
+            void operator+=(const Vector3A& v){
+                _mm_store_ps(data, _mm_add_ps(simd(), v.simd()));
+            }
+
+            Vector3A operator+(const Vector3A& v) const{
+                return Vector3A(_mm_add_ps(simd(), v.simd()));
+            }
+
+            void operator-=(const Vector3A& v){
+                _mm_store_ps(data, _mm_sub_ps(simd(), v.simd()));
+            }
+
+            Vector3A operator-(const Vector3A& v) const{
+                return Vector3A(_mm_sub_ps(simd(), v.simd()));
+            }
+
+            void operator*=(const real value){
+                _mm_store_ps(data, _mm_mul_ps(simd(), _mm_set1_ps(value)));
+            }
+
+            Vector3A operator*(const real value) const{
+                return Vector3A(_mm_mul_ps(simd(), _mm_set1_ps(value)));
+            }
+
+            void addScaledVector(const Vector3A& v, real scale){
+                _mm_store_ps(data, _mm_add_ps(simd(), _mm_mul_ps(v.simd(), _mm_set1_ps(scale))));
+            }
+
+            Vector3A componentProduct(const Vector3A& v) const{
+                return Vector3A(_mm_mul_ps(simd(), v.simd()));
+            }
+
+            void componentProductUpdate(const Vector3A& v){
+                _mm_store_ps(data, _mm_mul_ps(simd(), v.simd()));
+            }
+
+            real scalarProduct(const Vector3A& v) const{
+                __m128 product = _mm_mul_ps(simd(), v.simd());
+                __m128 pairs = _mm_add_ps(product, _mm_movehl_ps(product, product));
+                return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+            }
+
+            Vector3A vectorProduct(const Vector3A& v) const{
+                // (y, z, x) * (v.z, v.x, v.y) - (z, x, y) * (v.y, v.z, v.x)
+                __m128 a = simd(), b = v.simd();
+                __m128 ayzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+                __m128 azxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+                __m128 byzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+                __m128 bzxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+                return Vector3A(_mm_sub_ps(_mm_mul_ps(ayzx, bzxy), _mm_mul_ps(azxy, byzx)));
+            }
+
+            void invert(){
+                _mm_store_ps(data, _mm_sub_ps(_mm_setzero_ps(), simd()));
+            }
+
+            void clear(){
+                _mm_store_ps(data, _mm_setzero_ps());
+            }
+#else
+            void operator+=(const Vector3A& v){
+                x += v.x;
+                y += v.y;
+                z += v.z;
+            }
+
+            Vector3A operator+(const Vector3A& v) const{
+                return Vector3A(x+v.x, y+v.y, z+v.z);
+            }
+
+            void operator-=(const Vector3A& v){
+                x -= v.x;
+                y -= v.y;
+                z -= v.z;
+            }
+
+            Vector3A operator-(const Vector3A& v) const{
+                return Vector3A(x-v.x, y-v.y, z-v.z);
+            }
+
+            void operator*=(const real value){
+                x *= value;
+                y *= value;
+                z *= value;
+            }
+
+            Vector3A operator*(const real value) const{
+                return Vector3A(x*value, y*value, z*value);
+            }
+
+            void addScaledVector(const Vector3A& v, real scale){
+                x += v.x * scale;
+                y += v.y * scale;
+                z += v.z * scale;
+            }
+
+            Vector3A componentProduct(const Vector3A& v) const{
+                return Vector3A(x*v.x, y*v.y, z*v.z);
+            }
+
+            void componentProductUpdate(const Vector3A& v){
+                x *= v.x;
+                y *= v.y;
+                z *= v.z;
+            }
+
+            real scalarProduct(const Vector3A& v) const{
+                return x*v.x + y*v.y + z*v.z;
+            }
+
+            Vector3A vectorProduct(const Vector3A& v) const{
+                return Vector3A(y*v.z - z*v.y,
+                                z*v.x - x*v.z,
+                                x*v.y - y*v.x);
+            }
+
+            void invert(){
+                x = -x;
+                y = -y;
+                z = -z;
+            }
+
+            void clear(){
+                x = y = z = 0;
+            }
+#endif
+
+            real operator*(const Vector3A& v) const{
+                return scalarProduct(v);
+            }
+
+            void operator%=(const Vector3A& v){
+                *this = vectorProduct(v);
+            }
+
+            Vector3A operator%(const Vector3A& v) const{
+                return vectorProduct(v);
+            }
+
+            real magnitude() const{
+                return real_sqrt(squareMagnitude());
+            }
+
+            real squareMagnitude() const {
+                return scalarProduct(*this);
+            }
+
+            void normalize() {
+                real norm = magnitude();
+                if (norm > 0){
+                    (*this)*=((real)1)/norm;
+                }
+            }
+
+            Vector3A unit() const{
+                Vector3A result = *this;
+                result.normalize();
+                return result;
+            }
+
+            void trim(real size){
+                if (squareMagnitude() > size){
+                    normalize();
+                    (*this)*=size;
+                }
+            }
+    };
+
+    static_assert(sizeof(Vector3A) == 4 * sizeof(real), "Vector3A must be exactly four components");
+    static_assert(std::is_trivially_copyable<Vector3A>::value, "Vector3A must be trivially copyable");
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef MY_MATH_VECTOR_ARRAY_H
+#define MY_MATH_VECTOR_ARRAY_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+
+namespace my{
+    /**
+     * Holds a sequence of vectors as three separate component
+     * arrays, so that loops over many vectors stream linearly
+     * through memory and can be vectorised by the compiler.
+     */
+    class Vector3Array{
+        public:
+            std::vector<real> x;
+            std::vector<real> y;
+            std::vector<real> z;
+
+        public:
+            std::size_t size() const{
+                return x.size();
+            }
+
+            void reserve(std::size_t count){
+                x.reserve(count);
+                y.reserve(count);
+                z.reserve(count);
+            }
+
+            void resize(std::size_t count){
+                x.resize(count);
+                y.resize(count);
+                z.resize(count);
+            }
+
+            void clear(){
+                x.clear();
+                y.clear();
+                z.clear();
+            }
+
+            void push_back(const Vector3 &v){
+                x.push_back(v.x);
+                y.push_back(v.y);
+                z.push_back(v.z);
+            }
+
+            /**
+             * Moves the last vector into the given slot and drops the
+             * last slot.
+             */
+            void swapRemove(std::size_t i){
+                x[i] = x.back(); x.pop_back();
+                y[i] = y.back(); y.pop_back();
+                z[i] = z.back(); z.pop_back();
+            }
+
+            Vector3 get(std::size_t i) const{
+                return Vector3(x[i], y[i], z[i]);
+            }
+
+            void set(std::size_t i, const Vector3 &v){
+                x[i] = v.x;
+                y[i] = v.y;
+                z[i] = v.z;
+            }
+
+            void add(std::size_t i, const Vector3 &v){
+                x[i] += v.x;
+                y[i] += v.y;
+                z[i] += v.z;
+            }
+
+            void addScaledVector(std::size_t i, const Vector3 &v, real scale){
+                x[i] += v.x * scale;
+                y[i] += v.y * scale;
+                z[i] += v.z * scale;
+            }
+
+            void fill(real value){
+                for (auto &c : x) c = value;
+                for (auto &c : y) c = value;
+                for (auto &c : z) c = value;
+            }
+    };
+
+    /**
+     * Holds a sequence of values with N components each, such as
+     * quaternions or matrices, as N separate component arrays:
+     * c[k][i] is component k of value i.
+     */
+    template<unsigned N>
+    class ComponentArray{
+        public:
+            std::vector<real> c[N];
+
+        public:
+            std::size_t size() const{
+                return c[0].size();
+            }
+
+            void reserve(std::size_t count){
+                for (auto &component : c) component.reserve(count);
+            }
+
+            void resize(std::size_t count){
+                for (auto &component : c) component.resize(count);
+            }
+
+            void clear(){
+                for (auto &component : c) component.clear();
+            }
+
+            /**
+             * Moves the last value into the given slot and drops the
+             * last slot.
+             */
+            void swapRemove(std::size_t i){
+                for (auto &component : c){
+                    component[i] = component.back();
+                    component.pop_back();
+                }
+            }
+
+            void swap(std::size_t i, std::size_t j){
+                for (auto &component : c) std::swap(component[i], component[j]);
+            }
+
+        protected:
+            void pushComponents(const real *data){
+                for (unsigned k = 0; k < N; k++) c[k].push_back(data[k]);
+            }
+
+            void getComponents(std::size_t i, real *data) const{
+                for (unsigned k = 0; k < N; k++) data[k] = c[k][i];
+            }
+
+            void setComponents(std::size_t i, const real *data){
+                for (unsigned k = 0; k < N; k++) c[k][i] = data[k];
+            }
+    };
+
+    /**
+     * Quaternions as r, i, j and k component arrays.
+     */
+    class QuaternionArray : public ComponentArray<4>{
+        public:
+            void push_back(const Quaternion &q){
+                pushComponents(q.data);
+            }
+
+            Quaternion get(std::size_t i) const{
+                Quaternion q;
+                getComponents(i, q.data);
+                return q;
+            }
+
+            void set(std::size_t i, const Quaternion &q){
+                setComponents(i, q.data);
+            }
+    };
+
+    /**
+     * 3x3 matrices as nine component arrays, in the order of
+     * Matrix3::data.
+     */
+    class Matrix3Array : public ComponentArray<9>{
+        public:
+            void push_back(const Matrix3 &m){
+                pushComponents(m.data);
+            }
+
+            Matrix3 get(std::size_t i) const{
+                Matrix3 m;
+                getComponents(i, m.data);
+                return m;
+            }
+
+            void set(std::size_t i, const Matrix3 &m){
+                setComponents(i, m.data);
+            }
+    };
+
+    /**
+     * 3x4 transform matrices as twelve component arrays, in the order
+     * of Matrix4::data.
+     */
+    class Matrix4Array : public ComponentArray<12>{
+        public:
+            void push_back(const Matrix4 &m){
+                pushComponents(m.data);
+            }
+
+            Matrix4 get(std::size_t i) const{
+                Matrix4 m;
+                getComponents(i, m.data);
+                return m;
+            }
+
+            void set(std::size_t i, const Matrix4 &m){
+                setComponents(i, m.data);
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef MY_SCENE_H
+#define MY_SCENE_H
+
+#include <math/precision.hpp>
+#include <memory>
+#include <structre/step_profiler.hpp>
+#include <structre/trace_recorder.hpp>
+
+
+/**
+ * A scene holds the physics of one demonstration without any of its
+ * rendering, so the same simulation can be stepped by a windowed
+ * Application or by the headless runner on a machine without a
+ * display.
+ */
+class Scene
+{
+public:
+    virtual ~Scene() {}
+
+    /**
+     * Gets the name of the scene, used to select it on the command
+     * line and in reports.
+     */
+    virtual const char* getTitle() = 0;
+
+    /**
+     * Advances the simulation by the given duration in seconds.
+     */
+    virtual void step(my::real duration) = 0;
+
+    /**
+     * Stands in for the input a user would give the windowed demo,
+     * so the scene keeps doing work when nobody is at the keyboard.
+     * Called by the headless runner before each step.
+     *
+     * The default implementation does nothing.
+     */
+    virtual void autoplay(my::real duration) {}
+
+    /**
+     * Returns how many particles are currently being simulated.
+     */
+    virtual unsigned getParticleCount() = 0;
+
+    /**
+     * Passes a trace recorder on to the scene's world, if it has one.
+     *
+     * The default implementation does nothing.
+     */
+    virtual void setTraceRecorder(std::shared_ptr<my::TraceRecorder> recorder) {}
+
+    /**
+     * Returns the step profiles of the scene's world, or null if the
+     * scene is not simulated by a ParticleWorld. The profiles are
+     * empty unless built with MY_PROFILE.
+     */
+    virtual const my::StepProfiler* getProfiler() { return nullptr; }
+};
+
+#endif
@@ -1,13 +1,27 @@
 #pragma once
 
 #include "math/base.hpp"
+#include <assert.h>
 #include <my.h>
 
 namespace my{
+    /**
+     * A rigid body: a particle that also has an orientation, spins,
+     * and responds to torque through its inertia tensor.
+     *
+     * The transform matrix and world-space inverse inertia tensor are
+     * derived from the position and orientation. integrate updates
+     * them, and calculateDerivedData must be called after changing
+     * the position or orientation directly.
+     */
     class RigidBody{
-        private:
-        void _transformInertiaTensor(Matrix3 &iitWorld,
-                                                   const Quaternion &q,
+        public:
+        /**
+         * Sets iitWorld to the body-space inverse inertia tensor
+         * iitBody rotated into world space by the rotation part of
+         * rotmat, i.e. R * iitBody * R^T.
+         */
+        static inline void _transformInertiaTensor(Matrix3 &iitWorld,
                                                    const Matrix3 &iitBody,
                                                    const Matrix4 &rotmat){
             real t4 = rotmat.data[0]*iitBody.data[0]+
@@ -67,6 +81,10 @@ namespace my{
                 t62*rotmat.data[10];
         }
 
+        /**
+         * Sets the transform matrix to the rotation of the (unit)
+         * orientation followed by the translation to position.
+         */
         static inline void _calculateTransformMatrix(Matrix4 &transformMatrix,
                                                      const Vector3 &position,
                                                      const Quaternion &orientation){
@@ -96,12 +114,12 @@ namespace my{
         }
 
         protected:
-            bool isAwake;
-            bool canSleep;
-            real linearDamping;
-            real angularDamping;
-            real inverseMass;
-            real motion;
+            bool isAwake = true;
+            bool canSleep = true;
+            real linearDamping = 1;
+            real angularDamping = 1;
+            real inverseMass = 1;
+            real motion = REAL_MAX;
             Vector3 position;
             Vector3 velocity;
             Vector3 acceleration;
@@ -115,17 +133,102 @@ namespace my{
             Matrix4 transformMatrix;
         
         public:
-
             void setMass(const real mass){
                 assert(mass > 0.0);
                 inverseMass = ((real)1)/mass;                
             }
 
+            void setInverseMass(const real invMass){
+                inverseMass = invMass;
+            }
+
             void setDamping(const real ldamp, const real adamp){
                 linearDamping = ldamp;
                 angularDamping = adamp;
             }
 
+            real getLinearDamping() const{
+                return linearDamping;
+            }
+
+            real getAngularDamping() const{
+                return angularDamping;
+            }
+
+            /**
+             * Sets the body-space inertia tensor. It must be
+             * invertible.
+             */
+            void setInertiaTensor(const Matrix3 &inertiaTensor){
+                inverseInertiaTensor.setInverse(inertiaTensor);
+            }
+
+            void setInverseInertiaTensor(const Matrix3 &inverseInertiaTensor){
+                RigidBody::inverseInertiaTensor = inverseInertiaTensor;
+            }
+
+            Matrix3 getInverseInertiaTensor() const{
+                return inverseInertiaTensor;
+            }
+
+            Matrix3 getInverseInertiaTensorWorld() const{
+                return inverseInertiaTensorWorld;
+            }
+
+            void setOrientation(const Quaternion &orientation){
+                RigidBody::orientation = orientation;
+                RigidBody::orientation.normalise();
+            }
+
+            Quaternion getOrientation() const{
+                return orientation;
+            }
+
+            /**
+             * Sets the angular velocity, in world space.
+             */
+            void setRotation(const Vector3 &rotation){
+                RigidBody::rotation = rotation;
+            }
+
+            Vector3 getRotation() const{
+                return rotation;
+            }
+
+            Matrix4 getTransform() const{
+                return transformMatrix;
+            }
+
+            /**
+             * Returns the acceleration of the last integration step,
+             * including the one caused by the accumulated force.
+             */
+            Vector3 getLastFrameAcceleration() const{
+                return lastFrameAcceleration;
+            }
+
+            Vector3 getPointInWorldSpace(const Vector3 &point) const{
+                return transformMatrix.transform(point);
+            }
+
+            Vector3 getForceAccum() const{
+                return forceAccum;
+            }
+
+            Vector3 getTorqueAccum() const{
+                return torqueAccum;
+            }
+
+            /**
+             * Recomputes the transform matrix and world-space inverse
+             * inertia tensor from the position and orientation.
+             */
+            void calculateDerivedData(){
+                orientation.normalise();
+                _calculateTransformMatrix(transformMatrix, position, orientation);
+                _transformInertiaTensor(inverseInertiaTensorWorld, inverseInertiaTensor, transformMatrix);
+            }
+
             void setPosition(const Vector3& posi){
                 position.x = posi.x;
                 position.y = posi.y;
@@ -170,23 +273,97 @@ namespace my{
                 forceAccum.z = z;
             }
 
+            void setTorqueAccum(const Vector3& torque){
+                torqueAccum = torque;
+            }
+
             void clearAccumulator(){
                 forceAccum.clear();
+                torqueAccum.clear();
             }
 
-
-            void integrate(real &duration){
+            /**
+             * Advances the body by the given duration. Velocities are
+             * updated from the accumulated force and torque first and
+             * then move the body, and the derived data is
+             * recalculated at the end.
+             */
+            void integrate(real duration){
                 assert(duration > 0.0);
+                if (!isAwake) return;
+
+                lastFrameAcceleration = acceleration;
+                lastFrameAcceleration.addScaledVector(forceAccum, inverseMass);
+                Vector3 angularAcceleration = inverseInertiaTensorWorld.transform(torqueAccum);
+
+                velocity.addScaledVector(lastFrameAcceleration, duration);
+                rotation.addScaledVector(angularAcceleration, duration);
+                velocity *= real_pow(linearDamping, duration);
+                rotation *= real_pow(angularDamping, duration);
 
                 position.addScaledVector(velocity, duration);
-                Vector3 resultAcc = acceleration;
-                resultAcc.addScaledVector(forceAccum, inverseMass);
-                velocity.addScaledVector(resultAcc, duration);
-                velocity *= real_pow(damping, duration);
+                orientation.addScaledVector(rotation, duration);
 
+                calculateDerivedData();
                 clearAccumulator();
             }
 
+            /**
+             * Keeps a running average of the squared linear and angular
+             * speed, capped so that a fast body which stops falls
+             * asleep quickly, and puts the body to sleep when it drops
+             * below the given threshold. Call after integrate with the
+             * threshold of whatever steps the body, as RigidBodyWorld
+             * does for the bodies it holds.
+             */
+            void updateMotion(real duration, real sleepEpsilon){
+                if (!canSleep || !isAwake) return;
+                real currentMotion = velocity * velocity + rotation * rotation;
+                real bias = real_pow((real)0.5, duration);
+                motion = bias * motion + (1 - bias) * currentMotion;
+
+                if (motion < sleepEpsilon) setAwake(false);
+                else if (motion > 10 * sleepEpsilon) motion = 10 * sleepEpsilon;
+            }
+
+            /**
+             * Wakes or sleeps the body. A sleeping body is not
+             * integrated and loses its velocity and rotation. A woken
+             * body's motion is reset high, so it is not put straight
+             * back to sleep.
+             */
+            void setAwake(const bool awake = true){
+                if (awake){
+                    isAwake = true;
+                    motion = REAL_MAX;
+                }else{
+                    isAwake = false;
+                    velocity.clear();
+                    rotation.clear();
+                }
+            }
+
+            bool getAwake() const{
+                return isAwake;
+            }
+
+            /**
+             * Bodies that cannot sleep, such as ones the user
+             * controls, are woken if asleep and kept awake.
+             */
+            void setCanSleep(const bool canSleep = true){
+                RigidBody::canSleep = canSleep;
+                if (!canSleep && !isAwake) setAwake();
+            }
+
+            bool getCanSleep() const{
+                return canSleep;
+            }
+
+            real getMotion() const{
+                return motion;
+            }
+
             void getPosition(Vector3* pposi) const{
                 *pposi = position;
             }
@@ -211,12 +388,45 @@ namespace my{
                 return acceleration;
             }
 
-            void addVelocity(Vector3 &velo){
+            void addVelocity(const Vector3 &velo){
                 velocity += velo;
             }
 
+            /**
+             * Adds a force at the centre of mass, waking the body if
+             * it is asleep.
+             */
             void addForce(const Vector3 &force){
                 forceAccum += force;
+                if (!isAwake) setAwake();
+            }
+
+            /**
+             * Adds a torque, in world space, waking the body if it is
+             * asleep.
+             */
+            void addTorque(const Vector3 &torque){
+                torqueAccum += torque;
+                if (!isAwake) setAwake();
+            }
+
+            /**
+             * Adds a force applied at the given world-space point,
+             * which also twists the body about its centre of mass.
+             */
+            void addForceAtPoint(const Vector3 &force, const Vector3 &point){
+                Vector3 arm = point - position;
+                forceAccum += force;
+                torqueAccum += arm % force;
+                if (!isAwake) setAwake();
+            }
+
+            /**
+             * Adds a world-space force applied at the given point in
+             * body space. Uses the derived transform.
+             */
+            void addForceAtBodyPoint(const Vector3 &force, const Vector3 &point){
+                addForceAtPoint(force, getPointInWorldSpace(point));
             }
 
             bool hasFiniteMass() const{
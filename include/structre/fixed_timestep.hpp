@@ -0,0 +1,145 @@
+#pragma once
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+#include "math/vector_array.hpp"
+#include "structre/particle_store.hpp"
+#include <cmath>
+#include <cstddef>
+
+namespace my{
+/**
+ * Turns variable frame durations into a whole number of fixed-length
+ * physics steps. Time left over from a frame is carried to the next
+ * one, and getAlpha() says how far between the last two steps the
+ * frame actually ended, for interpolating what is drawn.
+ *
+ * At most maxSubsteps steps are taken per frame. After a slow frame
+ * the time beyond that is dropped instead of carried over, so the
+ * simulation falls behind the wall clock rather than taking ever
+ * longer frames to catch up.
+ */
+class FixedTimestep{
+    protected:
+    real stepDuration;
+    unsigned maxSubsteps;
+    real accumulator = 0;
+    real droppedTime = 0;
+
+    public:
+    FixedTimestep(real stepDuration = (real)1.0 / 60, unsigned maxSubsteps = 4) : stepDuration(stepDuration), maxSubsteps(maxSubsteps){}
+
+    void setStepDuration(real stepDuration){
+        FixedTimestep::stepDuration = stepDuration;
+    }
+
+    real getStepDuration() const{
+        return stepDuration;
+    }
+
+    void setMaxSubsteps(unsigned maxSubsteps){
+        FixedTimestep::maxSubsteps = maxSubsteps;
+    }
+
+    /**
+     * Adds the frame's duration to the accumulated time and calls
+     * step(getStepDuration()) once for each whole step it now holds,
+     * up to the maximum. Returns how many steps were taken.
+     */
+    template<class Step>
+    unsigned advance(real frameDuration, Step step){
+        if (frameDuration > 0) accumulator += frameDuration;
+
+        unsigned steps = 0;
+        while (accumulator >= stepDuration && steps < maxSubsteps){
+            step(stepDuration);
+            accumulator -= stepDuration;
+            steps++;
+        }
+
+        if (accumulator >= stepDuration){
+            real remainder = real_mod(accumulator, stepDuration);
+            droppedTime += accumulator - remainder;
+            accumulator = remainder;
+        }
+        return steps;
+    }
+
+    /**
+     * Returns the fraction of a step that has accumulated but not yet
+     * been simulated, in [0, 1).
+     */
+    real getAlpha() const{
+        return accumulator / stepDuration;
+    }
+
+    /**
+     * Returns the total time dropped because frames needed more than
+     * maxSubsteps steps.
+     */
+    real getDroppedTime() const{
+        return droppedTime;
+    }
+
+    void reset(){
+        accumulator = 0;
+        droppedTime = 0;
+    }
+};
+
+/**
+ * Remembers the positions of a store's particles before a step, so a
+ * renderer can draw them part way between that step and the next.
+ * If particles were added or removed since the positions were
+ * recorded, the current positions are used as they are.
+ */
+class PositionHistory{
+    protected:
+    Vector3Array previous;
+    unsigned layoutVersion = ~0u;
+
+    public:
+    /**
+     * Records the current positions. Call this before each step.
+     */
+    void record(const ParticleStore &particles){
+        previous = particles.positions();
+        layoutVersion = particles.getLayoutVersion();
+    }
+
+    bool matches(const ParticleStore &particles) const{
+        return layoutVersion == particles.getLayoutVersion();
+    }
+
+    /**
+     * Returns the particle's position blended between the recorded
+     * one (alpha 0) and the current one (alpha 1).
+     */
+    Vector3 interpolate(const ParticleStore &particles, ParticleHandle particle, real alpha) const{
+        Vector3 current = particles.getPosition(particle);
+        if (!matches(particles)) return current;
+
+        Vector3 blended = previous.get(particles.indexOf(particle));
+        blended.addScaledVector(current - blended, alpha);
+        return blended;
+    }
+
+    /**
+     * Writes every particle's blended position to out, by dense
+     * index.
+     */
+    void interpolate(const ParticleStore &particles, real alpha, Vector3Array &out) const{
+        out = particles.positions();
+        if (!matches(particles)) return;
+
+        const std::size_t count = out.size();
+        const real *px = previous.x.data(), *py = previous.y.data(), *pz = previous.z.data();
+        real *ox = out.x.data(), *oy = out.y.data(), *oz = out.z.data();
+        for (std::size_t i = 0; i < count; i++){
+            ox[i] = px[i] + (ox[i] - px[i]) * alpha;
+            oy[i] = py[i] + (oy[i] - py[i]) * alpha;
+            oz[i] = pz[i] + (oz[i] - pz[i]) * alpha;
+        }
+    }
+};
+}
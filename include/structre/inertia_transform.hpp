@@ -0,0 +1,179 @@
+#pragma once
+
+#include "math/precision.hpp"
+#include "structre/rigid_body_store.hpp"
+#include <cstddef>
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(MY_DOUBLE_PRECISION)
+#define MY_INERTIA_X86 1
+#include <immintrin.h>
+#endif
+
+namespace my{
+/**
+ * Rotates the inverse inertia tensors of a RigidBodyStore's bodies
+ * into world space four (SSE) or eight (AVX) bodies at a time, one
+ * body per lane, and with RigidBodyStore::transformInertiaTensors for
+ * the bodies left over or when the CPU has neither.
+ *
+ * The store keeps every matrix element in its own array, so each
+ * element of a batch is a single unaligned load and no shuffling is
+ * needed. The vector paths perform the same operations in the same
+ * order as the scalar loop and give the same results, unless the
+ * compiler contracts the scalar loop into fused multiply-adds.
+ */
+class InertiaTensorTransform{
+    public:
+    enum Mode{
+        SCALAR = 0,
+        SSE,
+        AVX,
+        BEST
+    };
+
+    protected:
+    Mode mode;
+
+    public:
+    InertiaTensorTransform(Mode mode = BEST) : mode(mode){}
+
+    void setMode(Mode mode){
+        InertiaTensorTransform::mode = mode;
+    }
+
+    Mode getMode() const{
+        return mode;
+    }
+
+    /**
+     * Returns whether the given mode can run on this CPU.
+     */
+    static bool supports(Mode mode){
+        switch (mode){
+#ifdef MY_INERTIA_X86
+        case SSE: return __builtin_cpu_supports("sse2");
+        case AVX: return __builtin_cpu_supports("avx");
+#else
+        case SSE: return false;
+        case AVX: return false;
+#endif
+        default: return true;
+        }
+    }
+
+    /**
+     * Returns the mode that will actually run for the requested one,
+     * falling back to the next narrower path the CPU supports.
+     */
+    static Mode resolve(Mode mode){
+        if (mode == BEST) mode = AVX;
+        if (mode == AVX && !supports(AVX)) mode = SSE;
+        if (mode == SSE && !supports(SSE)) mode = SCALAR;
+        return mode;
+    }
+
+    /**
+     * Sets the world-space inverse inertia tensors of the bodies with
+     * dense indices in [begin, end) from their transforms, which must
+     * be up to date.
+     */
+    void transform(RigidBodyStore &bodies, std::size_t begin, std::size_t end){
+        std::size_t done = begin;
+        switch (resolve(mode)){
+#ifdef MY_INERTIA_X86
+        case AVX: done = transformAVX(bodies, begin, end); break;
+        case SSE: done = transformSSE(bodies, begin, end); break;
+#endif
+        default: break;
+        }
+        bodies.transformInertiaTensors(done, end);
+    }
+
+#ifdef MY_INERTIA_X86
+    protected:
+    /**
+     * Each vector path handles as many whole batches as fit from
+     * begin and returns the index of the first body it left.
+     *
+     * Per row of the rotation R, the row of R * I^-1 is formed first
+     * and then dotted with each row of R, so only three rotation
+     * elements and three products are live beside the tensor.
+     */
+    __attribute__((target("sse2")))
+    static std::size_t transformSSE(RigidBodyStore &bodies, std::size_t begin, std::size_t end){
+        const real *t[12], *b[9];
+        real *w[9];
+        for (unsigned k = 0; k < 12; k++) t[k] = bodies.transforms().c[k].data();
+        for (unsigned k = 0; k < 9; k++){
+            b[k] = bodies.inverseInertiaTensors().c[k].data();
+            w[k] = bodies.inverseInertiaTensorsWorld().c[k].data();
+        }
+
+        std::size_t i = begin;
+        for (; i + 4 <= end; i += 4){
+            __m128 body[9];
+            for (unsigned k = 0; k < 9; k++) body[k] = _mm_loadu_ps(b[k] + i);
+            __m128 rot[9];
+            for (unsigned r = 0; r < 3; r++){
+                for (unsigned c = 0; c < 3; c++) rot[r*3 + c] = _mm_loadu_ps(t[r*4 + c] + i);
+            }
+
+            for (unsigned r = 0; r < 3; r++){
+                __m128 row[3];
+                for (unsigned c = 0; c < 3; c++){
+                    row[c] = _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(rot[r*3], body[c]),
+                        _mm_mul_ps(rot[r*3 + 1], body[3 + c])),
+                        _mm_mul_ps(rot[r*3 + 2], body[6 + c]));
+                }
+                for (unsigned c = 0; c < 3; c++){
+                    _mm_storeu_ps(w[r*3 + c] + i, _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(row[0], rot[c*3]),
+                        _mm_mul_ps(row[1], rot[c*3 + 1])),
+                        _mm_mul_ps(row[2], rot[c*3 + 2])));
+                }
+            }
+        }
+        return i;
+    }
+
+    __attribute__((target("avx")))
+    static std::size_t transformAVX(RigidBodyStore &bodies, std::size_t begin, std::size_t end){
+        const real *t[12], *b[9];
+        real *w[9];
+        for (unsigned k = 0; k < 12; k++) t[k] = bodies.transforms().c[k].data();
+        for (unsigned k = 0; k < 9; k++){
+            b[k] = bodies.inverseInertiaTensors().c[k].data();
+            w[k] = bodies.inverseInertiaTensorsWorld().c[k].data();
+        }
+
+        std::size_t i = begin;
+        for (; i + 8 <= end; i += 8){
+            __m256 body[9];
+            for (unsigned k = 0; k < 9; k++) body[k] = _mm256_loadu_ps(b[k] + i);
+            __m256 rot[9];
+            for (unsigned r = 0; r < 3; r++){
+                for (unsigned c = 0; c < 3; c++) rot[r*3 + c] = _mm256_loadu_ps(t[r*4 + c] + i);
+            }
+
+            for (unsigned r = 0; r < 3; r++){
+                __m256 row[3];
+                for (unsigned c = 0; c < 3; c++){
+                    row[c] = _mm256_add_ps(_mm256_add_ps(
+                        _mm256_mul_ps(rot[r*3], body[c]),
+                        _mm256_mul_ps(rot[r*3 + 1], body[3 + c])),
+                        _mm256_mul_ps(rot[r*3 + 2], body[6 + c]));
+                }
+                for (unsigned c = 0; c < 3; c++){
+                    _mm256_storeu_ps(w[r*3 + c] + i, _mm256_add_ps(_mm256_add_ps(
+                        _mm256_mul_ps(row[0], rot[c*3]),
+                        _mm256_mul_ps(row[1], rot[c*3 + 1])),
+                        _mm256_mul_ps(row[2], rot[c*3 + 2])));
+                }
+            }
+        }
+        return i;
+    }
+#endif
+};
+}
@@ -23,10 +23,18 @@ namespace my{
                 inverseMass = ((real)1)/mass;                
             }
 
+            void setInverseMass(const real invMass){
+                inverseMass = invMass;
+            }
+
             void setDamping(const real damp){
                 damping = damp;
             }
 
+            real getDamping() const{
+                return damping;
+            }
+
             void setPosition(const Vector3& posi){
                 position.x = posi.x;
                 position.y = posi.y;
@@ -76,7 +84,7 @@ namespace my{
             }
 
 
-            void integrate(real &duration){
+            void integrate(real duration){
                 assert(duration > 0.0);
 
                 position.addScaledVector(velocity, duration);
@@ -112,7 +120,11 @@ namespace my{
                 return acceleration;
             }
 
-            void addVelocity(Vector3 &velo){
+            Vector3 getForceAccum() const{
+                return forceAccum;
+            }
+
+            void addVelocity(const Vector3 &velo){
                 velocity += velo;
             }
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+#include "structre/particle_store.hpp"
+#include "structre/pcontacts.hpp"
+#include "structre/spatial_hash.hpp"
+#include <my.h>
+
+namespace my{
+/**
+ * Generates sphere-sphere contacts between all particles of the
+ * store, treating each as a sphere of the same radius.
+ *
+ * Candidate pairs come from a uniform grid with cells one diameter
+ * wide, stored as a spatial hash that is rebuilt every step with a
+ * counting sort. Each pair of neighbouring cells is scanned once, so
+ * the cost grows linearly with the number of particles at a given
+ * density. Pairs of sleeping particles are skipped.
+ */
+class ParticleCollisionGenerator : public ParticleContactGenerator{
+    protected:
+    real radius;
+    real restitution;
+    SpatialHash grid;
+
+    public:
+    ParticleCollisionGenerator(real radius, real restitution = 0.5f) : radius(radius), restitution(restitution){}
+
+    void setRadius(real radius){
+        ParticleCollisionGenerator::radius = radius;
+    }
+
+    void setRestitution(real restitution){
+        ParticleCollisionGenerator::restitution = restitution;
+    }
+
+    virtual void addContact(const ParticleStore &particles, ParticleContactArena &contacts){
+        if (particles.size() < 2) return;
+
+        const real diameter = 2 * radius;
+        const std::size_t awake = particles.getAwakeCount();
+        grid.build(particles.positions(), diameter);
+        grid.forEachPair(diameter, [&](unsigned i, unsigned j, real rx, real ry, real rz, real distanceSquared){
+            if (grid.originalIndex(i) >= awake && grid.originalIndex(j) >= awake) return true;
+            auto contact = contacts.allocate();
+            if (!contact) return false;
+
+            real distance = real_sqrt(distanceSquared);
+            if (distance > 0){
+                contact->contactNormal = Vector3(rx, ry, rz) * ((real)1 / distance);
+            }else{
+                contact->contactNormal = UP;
+            }
+            contact->particle[0] = particles.handleAt(grid.originalIndex(i));
+            contact->particle[1] = particles.handleAt(grid.originalIndex(j));
+            contact->penetration = diameter - distance;
+            contact->restitution = restitution;
+            return true;
+        });
+    }
+};
+}
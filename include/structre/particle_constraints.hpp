@@ -0,0 +1,237 @@
+#pragma once
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+#include "math/vector_array.hpp"
+#include "structre/particle_store.hpp"
+#include <cstddef>
+#include <my.h>
+#include <vector>
+
+namespace my{
+/**
+ * Keeps pairs of particles at a distance by moving their positions
+ * directly (extended position-based dynamics), as an alternative to
+ * turning ParticleRod and ParticleCable into contacts for the impulse
+ * resolver.
+ *
+ * A rod holds its particles at exactly its length and a cable at most
+ * its length. Each constraint has a compliance, the inverse of its
+ * stiffness: zero makes it rigid, larger values let it stretch like a
+ * spring under load. Compliance is independent of the iteration count
+ * and the step duration, so adding iterations only makes the result
+ * more accurate.
+ *
+ * The world calls solve() after integrating. Each iteration projects
+ * every constraint in turn (Gauss-Seidel), and the total correction
+ * of each particle divided by the step duration is then added to its
+ * velocity, so that particles do not fly apart again next step.
+ *
+ * Constraints are stored as flat arrays of handles, lengths and
+ * compliances; their dense indices are looked up again only when the
+ * store's layout or the constraints change.
+ */
+class DistanceConstraintSolver{
+    protected:
+    std::vector<ParticleHandle> first;
+    std::vector<ParticleHandle> second;
+    std::vector<real> length;
+    std::vector<real> compliance;
+    std::vector<unsigned char> cable;
+    unsigned iterations;
+
+    // Dense indices of the constraints' ends, and of every particle
+    // they touch, rebuilt when the store's layout or the constraints
+    // change.
+    std::vector<unsigned> firstIndex;
+    std::vector<unsigned> secondIndex;
+    std::vector<unsigned> touched;
+    unsigned indexedVersion = ~0u;
+    std::size_t indexedCount = 0;
+
+    // Scratch space reused between solves. start holds the positions
+    // of the touched particles before projection.
+    std::vector<real> lambda;
+    std::vector<unsigned char> marked;
+    Vector3Array start;
+
+    public:
+    DistanceConstraintSolver(unsigned iterations = 4) : iterations(iterations){}
+
+    void setIterations(unsigned iterations){
+        DistanceConstraintSolver::iterations = iterations;
+    }
+
+    unsigned getIterations() const{
+        return iterations;
+    }
+
+    /**
+     * Adds a constraint holding the two particles exactly the given
+     * length apart. Returns its index.
+     */
+    unsigned addRod(ParticleHandle a, ParticleHandle b, real length, real compliance = 0){
+        return add(a, b, length, compliance, false);
+    }
+
+    /**
+     * Adds a constraint keeping the two particles at most the given
+     * length apart. Returns its index.
+     */
+    unsigned addCable(ParticleHandle a, ParticleHandle b, real maxLength, real compliance = 0){
+        return add(a, b, maxLength, compliance, true);
+    }
+
+    void setCompliance(unsigned constraint, real compliance){
+        DistanceConstraintSolver::compliance[constraint] = compliance;
+    }
+
+    /**
+     * Sets the compliance of every constraint.
+     */
+    void setCompliance(real compliance){
+        for (auto &c : DistanceConstraintSolver::compliance) c = compliance;
+    }
+
+    std::size_t size() const{
+        return first.size();
+    }
+
+    void clear(){
+        first.clear();
+        second.clear();
+        length.clear();
+        compliance.clear();
+        cable.clear();
+        indexedCount = 0;
+    }
+
+    /**
+     * Returns how far the constraint's particles are from satisfying
+     * it: positive when too far apart, negative when a rod is too
+     * short, and zero for a slack cable.
+     */
+    real getError(const ParticleStore &particles, unsigned constraint) const{
+        Vector3 d = particles.getPosition(first[constraint]) - particles.getPosition(second[constraint]);
+        real error = d.magnitude() - length[constraint];
+        return (cable[constraint] && error < 0) ? 0 : error;
+    }
+
+    /**
+     * Projects the constraints onto the particles' positions and
+     * corrects their velocities to match. Sleeping particles are woken
+     * by a constraint to an awake particle; constraints between two
+     * sleeping particles are left alone.
+     */
+    void solve(ParticleStore &particles, real duration){
+        const std::size_t count = first.size();
+        if (count == 0 || iterations == 0 || duration <= 0) return;
+
+        if (particles.getAwakeCount() < particles.size()) wakeLinked(particles);
+
+        // Look up the dense indices after waking, which moves particles.
+        if (indexedVersion != particles.getLayoutVersion() || indexedCount != count) index(particles);
+        lambda.assign(count, 0);
+
+        real *px = particles.positions().x.data(), *py = particles.positions().y.data(), *pz = particles.positions().z.data();
+        const std::size_t touchedCount = touched.size();
+        start.resize(touchedCount);
+        real *sx = start.x.data(), *sy = start.y.data(), *sz = start.z.data();
+        for (std::size_t t = 0; t < touchedCount; t++){
+            sx[t] = px[touched[t]];
+            sy[t] = py[touched[t]];
+            sz[t] = pz[touched[t]];
+        }
+
+        const real *invMass = particles.inverseMasses().data();
+        const unsigned awake = (unsigned)particles.getAwakeCount();
+        const real alphaScale = (real)1 / (duration * duration);
+
+        for (unsigned iteration = 0; iteration < iterations; iteration++){
+            for (std::size_t c = 0; c < count; c++){
+                const unsigned a = firstIndex[c], b = secondIndex[c];
+                if (a >= awake && b >= awake) continue;
+
+                // A sleeping particle here is anchored to an immovable
+                // one, and stays put.
+                const real wa = a < awake ? invMass[a] : 0;
+                const real wb = b < awake ? invMass[b] : 0;
+                const real alpha = compliance[c] * alphaScale;
+                const real w = wa + wb + alpha;
+                if (w <= 0) continue;
+
+                real dx = px[a] - px[b], dy = py[a] - py[b], dz = pz[a] - pz[b];
+                real distance = real_sqrt(dx*dx + dy*dy + dz*dz);
+                if (distance <= 0) continue;
+                real error = distance - length[c];
+                if (cable[c] && error <= 0) continue;
+
+                real delta = (-error - alpha * lambda[c]) / w;
+                lambda[c] += delta;
+
+                real scale = delta / distance;
+                dx *= scale; dy *= scale; dz *= scale;
+                px[a] += dx * wa; py[a] += dy * wa; pz[a] += dz * wa;
+                px[b] -= dx * wb; py[b] -= dy * wb; pz[b] -= dz * wb;
+            }
+        }
+
+        real *vx = particles.velocities().x.data(), *vy = particles.velocities().y.data(), *vz = particles.velocities().z.data();
+        const real inverseDuration = (real)1 / duration;
+        for (std::size_t t = 0; t < touchedCount; t++){
+            const unsigned i = touched[t];
+            if (i >= awake) continue;
+            vx[i] += (px[i] - sx[t]) * inverseDuration;
+            vy[i] += (py[i] - sy[t]) * inverseDuration;
+            vz[i] += (pz[i] - sz[t]) * inverseDuration;
+        }
+    }
+
+    protected:
+    unsigned add(ParticleHandle a, ParticleHandle b, real restLength, real restCompliance, bool isCable){
+        first.push_back(a);
+        second.push_back(b);
+        length.push_back(restLength);
+        compliance.push_back(restCompliance);
+        cable.push_back(isCable);
+        return (unsigned)(first.size() - 1);
+    }
+
+    /**
+     * Looks up the dense indices of the constraints' ends, and lists
+     * each particle they touch once, in dense order.
+     */
+    void index(const ParticleStore &particles){
+        const std::size_t count = first.size();
+        firstIndex.resize(count);
+        secondIndex.resize(count);
+        marked.assign(particles.size(), 0);
+        for (std::size_t c = 0; c < count; c++){
+            firstIndex[c] = particles.indexOf(first[c]);
+            secondIndex[c] = particles.indexOf(second[c]);
+            marked[firstIndex[c]] = 1;
+            marked[secondIndex[c]] = 1;
+        }
+        touched.clear();
+        for (unsigned i = 0; i < (unsigned)marked.size(); i++){
+            if (marked[i]) touched.push_back(i);
+        }
+        indexedVersion = particles.getLayoutVersion();
+        indexedCount = count;
+    }
+
+    /**
+     * Wakes the sleeping end of every constraint whose other end is an
+     * awake particle with finite mass.
+     */
+    void wakeLinked(ParticleStore &particles){
+        for (std::size_t c = 0; c < first.size(); c++){
+            bool aAwake = particles.isAwake(first[c]);
+            bool bAwake = particles.isAwake(second[c]);
+            if (aAwake == bAwake) continue;
+            if (aAwake && particles.hasFiniteMass(first[c])) particles.setAwake(second[c], true);
+            if (bAwake && particles.hasFiniteMass(second[c])) particles.setAwake(first[c], true);
+        }
+    }
+};
+}
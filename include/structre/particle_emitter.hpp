@@ -0,0 +1,240 @@
+#pragma once
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+#include "math/random_stream.hpp"
+#include "math/vector_array.hpp"
+#include "structre/particle_integrator.hpp"
+#include "structre/particle_store.hpp"
+#include <assert.h>
+#include <cstddef>
+#include <my.h>
+#include <vector>
+
+namespace my{
+/**
+ * Describes one type of emitted particle: how long it lives, how it
+ * is launched, and which particles it releases when it dies.
+ */
+struct ParticleEmitterRule{
+    unsigned type = 0;
+    real minAge = 0;
+    real maxAge = 0;
+    Vector3 minVelocity;
+    Vector3 maxVelocity;
+    real damping = 1;
+
+    struct Payload{
+        unsigned type;
+        unsigned count;
+        void set(unsigned type, unsigned count){
+            Payload::type = type;
+            Payload::count = count;
+        }
+    };
+    std::vector<Payload> payloads;
+
+    void init(unsigned payload_count){
+        payloads.resize(payload_count);
+    }
+
+    void setParameters(unsigned type, real minAge, real maxAge, const Vector3& minVelocity, const Vector3 maxVelocity, real damping){
+        ParticleEmitterRule::type = type;
+        ParticleEmitterRule::minAge = minAge;
+        ParticleEmitterRule::maxAge = maxAge;
+        ParticleEmitterRule::minVelocity = minVelocity;
+        ParticleEmitterRule::maxVelocity = maxVelocity;
+        ParticleEmitterRule::damping = damping;
+    }
+};
+
+/**
+ * A pool of short-lived particles, such as fireworks, that spawn
+ * further particles when they die.
+ *
+ * Live particles are kept dense in a ParticleStore, with their
+ * remaining age and type in arrays alongside. A dying particle is
+ * swap-removed and its handle goes on the store's free list, so an
+ * update only touches live particles. Emitting never overwrites a
+ * live particle: once the pool holds capacity particles, further
+ * emissions are dropped.
+ */
+class ParticleEmitterSystem{
+    protected:
+    ParticleStore particles;
+    std::vector<real> age;
+    std::vector<unsigned> type;
+    std::vector<ParticleEmitterRule> rules;
+    std::size_t capacity;
+
+    ParticleIntegrator integrator;
+    RandomStream stream;
+    Vector3 acceleration;
+    real floorHeight;
+
+    // Scratch space reused between updates.
+    std::vector<unsigned> dying;
+    Vector3Array parentPosition;
+    Vector3Array parentVelocity;
+    Vector3Array launchVelocity;
+    std::vector<real> launchAge;
+
+    public:
+    ParticleEmitterSystem(std::size_t capacity, unsigned seed = 1) : capacity(capacity), stream(seed), acceleration(GRAVITY), floorHeight(-REAL_MAX){
+        particles.reserve(capacity);
+        age.reserve(capacity);
+        type.reserve(capacity);
+    }
+
+    /**
+     * Sets the rule for particles of the rule's type. Types start at
+     * one.
+     */
+    void setRule(const ParticleEmitterRule &rule){
+        assert(rule.type >= 1);
+        if (rules.size() < rule.type) rules.resize(rule.type);
+        rules[rule.type - 1] = rule;
+    }
+
+    /**
+     * Whether a rule has been set for the given type.
+     */
+    bool hasRule(unsigned type) const{
+        return type >= 1 && type <= rules.size() && rules[type - 1].type == type;
+    }
+
+    const ParticleEmitterRule &getRule(unsigned type) const{
+        assert(hasRule(type));
+        return rules[type - 1];
+    }
+
+    /**
+     * Sets the acceleration every emitted particle has, gravity by
+     * default.
+     */
+    void setAcceleration(const Vector3 &acceleration){
+        ParticleEmitterSystem::acceleration = acceleration;
+    }
+
+    /**
+     * Particles that fall below the given height die as if their age
+     * ran out. There is no floor by default.
+     */
+    void setFloor(real height){
+        floorHeight = height;
+    }
+
+    /**
+     * Emits count particles of the given type at the given position.
+     * Each gets the given velocity plus a random launch velocity and
+     * a random age from its rule. Returns how many were emitted,
+     * which is fewer than count when the pool is full, and none for
+     * a type without a rule.
+     */
+    unsigned emit(unsigned type, const Vector3 &position, const Vector3 &velocity, unsigned count){
+        if (!hasRule(type)) return 0;
+        const ParticleEmitterRule &rule = getRule(type);
+        const std::size_t first = particles.size();
+        if (first + count > capacity) count = (unsigned)(capacity - first);
+        if (count == 0) return 0;
+
+        launchVelocity.resize(count);
+        launchAge.resize(count);
+        stream.fillUniform(launchVelocity, 0, count, rule.minVelocity, rule.maxVelocity);
+        stream.fillUniform(launchAge.data(), count, rule.minAge, rule.maxAge);
+
+        Particle particle;
+        particle.setPosition(position);
+        particle.setAcceleration(acceleration);
+        particle.setDamping(rule.damping);
+        particle.setMass(1);
+        particles.add(particle, count);
+
+        Vector3Array &v = particles.velocities();
+        for (unsigned i = 0; i < count; i++){
+            v.x[first + i] = velocity.x + launchVelocity.x[i];
+            v.y[first + i] = velocity.y + launchVelocity.y[i];
+            v.z[first + i] = velocity.z + launchVelocity.z[i];
+        }
+        age.insert(age.end(), launchAge.begin(), launchAge.end());
+        ParticleEmitterSystem::type.insert(ParticleEmitterSystem::type.end(), count, type);
+        return count;
+    }
+
+    /**
+     * Advances every live particle, then replaces each one that died
+     * with its rule's payloads, launched from where it died with its
+     * velocity.
+     */
+    void update(real duration){
+        integrator.integrate(particles, duration);
+
+        const std::size_t count = particles.size();
+        const real *py = particles.positions().y.data();
+        dying.clear();
+        for (std::size_t i = 0; i < count; i++){
+            age[i] -= duration;
+            if (age[i] < 0 || py[i] < floorHeight) dying.push_back((unsigned)i);
+        }
+        if (dying.empty()) return;
+
+        // Note where the dying particles were before removing them, so
+        // the space they free can hold their payloads.
+        parentPosition.resize(dying.size());
+        parentVelocity.resize(dying.size());
+        for (std::size_t d = 0; d < dying.size(); d++){
+            unsigned index = dying[d];
+            parentPosition.set(d, particles.positions().get(index));
+            parentVelocity.set(d, particles.velocities().get(index));
+        }
+
+        // Removing from the back means a swapped-in particle is never
+        // one still waiting to be removed. The dying indices are then
+        // reused to hold the dead particles' types.
+        for (std::size_t d = dying.size(); d-- > 0;){
+            unsigned index = dying[d];
+            unsigned deadType = type[index];
+            particles.remove(particles.handleAt(index));
+            age[index] = age.back(); age.pop_back();
+            type[index] = type.back(); type.pop_back();
+            dying[d] = deadType;
+        }
+
+        for (std::size_t d = 0; d < dying.size(); d++){
+            for (const auto &payload : getRule(dying[d]).payloads){
+                emit(payload.type, parentPosition.get(d), parentVelocity.get(d), payload.count);
+            }
+        }
+    }
+
+    void clear(){
+        particles.clear();
+        age.clear();
+        type.clear();
+    }
+
+    std::size_t size() const{
+        return particles.size();
+    }
+
+    std::size_t getCapacity() const{
+        return capacity;
+    }
+
+    const ParticleStore &getParticles() const{
+        return particles;
+    }
+
+    /**
+     * Returns the remaining age of the particle at the given dense
+     * index of the store.
+     */
+    real getAge(std::size_t index) const{
+        return age[index];
+    }
+
+    unsigned getType(std::size_t index) const{
+        return type[index];
+    }
+};
+}
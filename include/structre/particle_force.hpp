@@ -1,41 +1,158 @@
 #pragma once
 
+#include "math/vector_array.hpp"
 #include "structre/particle.hpp"
+#include "structre/particle_store.hpp"
+#include "structre/trace_recorder.hpp"
+#include <cstddef>
 #include <memory>
 #include <my.h>
+#include <typeinfo>
+#include <unordered_map>
 #include <vector>
 
 namespace my{
 class ParticleForceGenerator{
     public:
-    virtual void updateForce(std::shared_ptr<Particle> particle, real duration) = 0;
+    /**
+     * Called once per step, before any updateForce call, for
+     * generators that compute forces for many particles together.
+     */
+    virtual void prepare(ParticleStore &particles, real duration){}
+
+    virtual void updateForce(ParticleStore &particles, ParticleHandle particle, real duration) = 0;
+
+    /**
+     * Applies the force to every particle in the batch. The default
+     * calls updateForce for each one; generators override it with a
+     * single loop over the store's arrays.
+     */
+    virtual void updateForces(ParticleStore &particles, const ParticleHandle *handles, std::size_t count, real duration){
+        for (std::size_t i = 0; i < count; i++){
+            updateForce(particles, handles[i], duration);
+        }
+    }
+
+    /**
+     * Called instead of updateForces for the sleeping particles of the
+     * batch. The default leaves them alone; a generator that pushes
+     * them from awake particles gives them the force with
+     * ParticleStore::addForce, which wakes them at the end of the
+     * pass.
+     */
+    virtual void updateSleepingForces(ParticleStore &particles, const ParticleHandle *handles, std::size_t count, real duration){}
+
+    protected:
+    /**
+     * For generators that buffer a force per dense index in prepare:
+     * gives each particle of the batch with a non-zero force its
+     * force, which wakes it if it sleeps.
+     */
+    static void addBufferedForces(ParticleStore &particles, const Vector3Array &force, const ParticleHandle *handles, std::size_t count){
+        const real *fx = force.x.data(), *fy = force.y.data(), *fz = force.z.data();
+        for (std::size_t i = 0; i < count; i++){
+            unsigned index = particles.indexOf(handles[i]);
+            if (fx[index] != 0 || fy[index] != 0 || fz[index] != 0) particles.addForce(handles[i], force.get(index));
+        }
+    }
 };
 
+/**
+ * Holds which force generators apply to which particles. Registrations
+ * are grouped by generator, so that each step makes one batched call
+ * per generator rather than one virtual call per registration.
+ */
 class ParticleForceRegistry{
     protected:
-    struct ParticleForceRegistration{
-        std::shared_ptr<Particle> particle;
+    struct ParticleForceGroup{
         std::shared_ptr<ParticleForceGenerator> fg;
+        std::vector<ParticleHandle> particles;
     };
-    typedef std::vector<ParticleForceRegistration> Registry;
-    Registry registrations;
+    typedef std::vector<ParticleForceGroup> Registry;
+    Registry groups;
+    std::unordered_map<const ParticleForceGenerator*, std::size_t> groupIndex;
+    std::size_t registrationCount = 0;
+    std::size_t dispatchedCount = 0;
+    TraceRecorder *trace = nullptr;
+    std::vector<ParticleHandle> awake;
+    std::vector<ParticleHandle> sleeping;
 
     public:
-    void addRegistration(std::shared_ptr<Particle> particle, std::shared_ptr<ParticleForceGenerator> fg){
-        ParticleForceRegistration new_registration;
-        new_registration.particle = particle;
-        new_registration.fg = fg;
-        registrations.push_back(new_registration);
+    void addRegistration(ParticleHandle particle, std::shared_ptr<ParticleForceGenerator> fg){
+        registrationCount++;
+        auto found = groupIndex.find(fg.get());
+        if (found != groupIndex.end()){
+            groups[found->second].particles.push_back(particle);
+            return;
+        }
+        groupIndex[fg.get()] = groups.size();
+        ParticleForceGroup new_group;
+        new_group.fg = fg;
+        new_group.particles.push_back(particle);
+        groups.push_back(new_group);
     }
 
-    void updateForces(real duration){
-        for (auto registration : registrations){
-            registration.fg->updateForce(registration.particle, duration);
+    /**
+     * Applies every generator to its awake particles, and lets it push
+     * its sleeping ones (see updateSleepingForces). Particles that
+     * addForce wakes during the pass are woken once it ends, so that
+     * dense indices stay put for the generators.
+     */
+    void updateForces(ParticleStore &particles, real duration){
+        particles.deferWakes(true);
+        for (const auto &group : groups){
+            TraceRecorder::Span span(trace, typeid(*group.fg).name(), "prepare", TraceRecorder::TYPE_NAME);
+            group.fg->prepare(particles, duration);
         }
+        const bool sleepers = particles.getAwakeCount() < particles.size();
+        dispatchedCount = 0;
+        for (const auto &group : groups){
+            TraceRecorder::Span span(trace, typeid(*group.fg).name(), "forces", TraceRecorder::TYPE_NAME);
+            if (!sleepers){
+                group.fg->updateForces(particles, group.particles.data(), group.particles.size(), duration);
+                dispatchedCount += group.particles.size();
+                continue;
+            }
+
+            // Sleeping particles get no forces until they are woken.
+            awake.clear();
+            sleeping.clear();
+            for (auto handle : group.particles){
+                if (particles.isAwake(handle)) awake.push_back(handle);
+                else sleeping.push_back(handle);
+            }
+            group.fg->updateForces(particles, awake.data(), awake.size(), duration);
+            group.fg->updateSleepingForces(particles, sleeping.data(), sleeping.size(), duration);
+            dispatchedCount += awake.size();
+        }
+        particles.deferWakes(false);
+    }
+
+    /**
+     * Records each generator's prepare and force update as a span,
+     * named after the generator's type. Null switches this off.
+     */
+    void setTraceRecorder(TraceRecorder *recorder){
+        trace = recorder;
+    }
+
+    std::size_t getRegistrationCount() const{
+        return registrationCount;
+    }
+
+    /**
+     * Returns how many registrations the last updateForces applied,
+     * leaving out those of sleeping particles.
+     */
+    std::size_t getDispatchedCount() const{
+        return dispatchedCount;
     }
 
     void clear(){
-        registrations.clear();
+        groups.clear();
+        groupIndex.clear();
+        registrationCount = 0;
+        dispatchedCount = 0;
     }
 };
 
@@ -44,9 +161,24 @@ class ParticleGravity : public ParticleForceGenerator{
     
     public:
     ParticleGravity(const Vector3 &grav) : gravity(grav){}
-    virtual void updateForce(std::shared_ptr<Particle> particle, real duration) override{
-        if(particle->hasFiniteMass()){
-            particle->addForce(gravity * particle->getMass());
+    virtual void updateForce(ParticleStore &particles, ParticleHandle particle, real duration) override{
+        if(particles.hasFiniteMass(particle)){
+            particles.addForce(particle, gravity * particles.getMass(particle));
+        }
+    }
+
+    virtual void updateForces(ParticleStore &particles, const ParticleHandle *handles, std::size_t count, real duration) override{
+        const real *invMass = particles.inverseMasses().data();
+        real *fx = particles.forceAccums().x.data();
+        real *fy = particles.forceAccums().y.data();
+        real *fz = particles.forceAccums().z.data();
+        for (std::size_t i = 0; i < count; i++){
+            unsigned index = particles.indexOf(handles[i]);
+            if (invMass[index] <= 0.0f) continue;
+            real mass = (real)1.0 / invMass[index];
+            fx[index] += gravity.x * mass;
+            fy[index] += gravity.y * mass;
+            fz[index] += gravity.z * mass;
         }
     }
 };
@@ -57,16 +189,35 @@ class ParticleDrag : public ParticleForceGenerator{
     
     public:
     ParticleDrag(real k1, real k2) : k1(k1), k2(k2){}
-    virtual void updateForce(std::shared_ptr<Particle> particle, real duration){
-        Vector3 force;
-        particle->getVelocity(&force);
+    virtual void updateForce(ParticleStore &particles, ParticleHandle particle, real duration){
+        Vector3 force = particles.getVelocity(particle);
 
         real dragCoeff = force.magnitude();
         dragCoeff = k1 * dragCoeff + k2 * dragCoeff * dragCoeff;
 
         force.normalize();
         force *= -dragCoeff;
-        particle->addForce(force);
+        particles.addForce(particle, force);
+    }
+
+    virtual void updateForces(ParticleStore &particles, const ParticleHandle *handles, std::size_t count, real duration) override{
+        const real *vx = particles.velocities().x.data();
+        const real *vy = particles.velocities().y.data();
+        const real *vz = particles.velocities().z.data();
+        real *fx = particles.forceAccums().x.data();
+        real *fy = particles.forceAccums().y.data();
+        real *fz = particles.forceAccums().z.data();
+        for (std::size_t i = 0; i < count; i++){
+            unsigned index = particles.indexOf(handles[i]);
+            real speed = real_sqrt(vx[index]*vx[index] + vy[index]*vy[index] + vz[index]*vz[index]);
+            if (speed <= 0) continue;
+
+            // -(k1*|v| + k2*|v|^2) * v/|v|
+            real scale = -(k1 + k2 * speed);
+            fx[index] += vx[index] * scale;
+            fy[index] += vy[index] * scale;
+            fz[index] += vz[index] * scale;
+        }
     }
 };
 }
\ No newline at end of file
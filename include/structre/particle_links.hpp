@@ -1,24 +1,29 @@
 #pragma once
 
 #include "math/base.hpp"
+#include "math/precision.hpp"
+#include "math/vector_array.hpp"
 #include "structre/particle.hpp"
+#include "structre/particle_store.hpp"
 #include "structre/pcontacts.hpp"
+#include <cstddef>
 #include <memory>
 #include <my.h>
+#include <vector>
 
 namespace my{
 class ParticleLink{
     public:
-    std::shared_ptr<Particle> particle[2];
+    ParticleHandle particle[2];
 
     protected:
-    real currentLength() const{
-        Vector3 relativePos = particle[0]->getPosition() - particle[1]->getPosition();
+    real currentLength(const ParticleStore &particles) const{
+        Vector3 relativePos = particles.getPosition(particle[0]) - particles.getPosition(particle[1]);
         return relativePos.magnitude();
     }
 
-    private:
-    virtual unsigned fillContact(std::shared_ptr<ParticleContact> contact, unsigned limit) const = 0;
+    public:
+    virtual unsigned fillContact(const ParticleStore &particles, ParticleContact *contact, unsigned limit) const = 0;
 };
 
 class ParticleCable : public ParticleLink{
@@ -27,14 +32,14 @@ class ParticleCable : public ParticleLink{
     real restitution;
     
     public:
-    virtual unsigned fillContact(std::shared_ptr<ParticleContact> contact, unsigned limit) const{
-        auto length = currentLength();
+    virtual unsigned fillContact(const ParticleStore &particles, ParticleContact *contact, unsigned limit) const{
+        auto length = currentLength(particles);
         if (length < maxLength) return 0;
 
         contact->particle[0] = particle[0];
         contact->particle[1] = particle[1];
 
-        Vector3 normal = particle[1]->getPosition() - particle[0]->getPosition();
+        Vector3 normal = particles.getPosition(particle[1]) - particles.getPosition(particle[0]);
         normal.normalize();
         contact->contactNormal = normal;
 
@@ -50,14 +55,14 @@ class ParticleRod : public ParticleLink{
     real length;
     
     public:
-    virtual unsigned fillContact(std::shared_ptr<ParticleContact> contact, unsigned limit) const{
-        auto curlength = currentLength();
+    virtual unsigned fillContact(const ParticleStore &particles, ParticleContact *contact, unsigned limit) const{
+        auto curlength = currentLength(particles);
         if (curlength == length) return 0;
 
         contact->particle[0] = particle[0];
         contact->particle[1] = particle[1];
 
-        Vector3 normal = particle[1]->getPosition() - particle[0]->getPosition();
+        Vector3 normal = particles.getPosition(particle[1]) - particles.getPosition(particle[0]);
         normal.normalize();
 
         if (curlength > length){
@@ -65,11 +70,156 @@ class ParticleRod : public ParticleLink{
             contact->penetration = curlength - length;
         }else{
             contact->contactNormal = normal * -1;
-            contact->penetration = curlength - length;
+            contact->penetration = length - curlength;
         }
 
         contact->restitution = 0;
         return 1;
     }
 };
-}
\ No newline at end of file
+
+/**
+ * Holds many cables and rods as flat arrays of particle handles,
+ * lengths and restitutions, and generates the contacts of all of them
+ * in one pass, instead of one ParticleLink object and virtual call per
+ * link. Add it to the world's contact generators.
+ *
+ * The dense indices of the linked particles are cached and only looked
+ * up again when the store's layout changes. Each pass first gathers
+ * the separation of every link into arrays, then measures them all in
+ * one loop, and only then writes contacts for the links that need
+ * them. Links between two sleeping particles generate nothing.
+ */
+class ParticleLinkRegistry : public ParticleContactGenerator{
+    protected:
+    std::vector<ParticleHandle> first;
+    std::vector<ParticleHandle> second;
+    std::vector<real> length;
+    std::vector<real> restitution;
+    std::vector<unsigned char> rod;
+
+    // Scratch space reused between passes.
+    std::vector<unsigned> firstIndex;
+    std::vector<unsigned> secondIndex;
+    unsigned indexedVersion = ~0u;
+    std::size_t indexedCount = 0;
+    Vector3Array separation;
+    std::vector<real> distance;
+
+    public:
+    /**
+     * Adds a cable letting the particles be at most maxLength apart.
+     * Returns its index.
+     */
+    unsigned addCable(ParticleHandle a, ParticleHandle b, real maxLength, real restitution){
+        return add(a, b, maxLength, restitution, false);
+    }
+
+    /**
+     * Adds a rod holding the particles exactly length apart. Returns
+     * its index.
+     */
+    unsigned addRod(ParticleHandle a, ParticleHandle b, real length){
+        return add(a, b, length, 0, true);
+    }
+
+    unsigned add(const ParticleCable &cable){
+        return addCable(cable.particle[0], cable.particle[1], cable.maxLength, cable.restitution);
+    }
+
+    unsigned add(const ParticleRod &rod){
+        return addRod(rod.particle[0], rod.particle[1], rod.length);
+    }
+
+    std::size_t size() const{
+        return first.size();
+    }
+
+    void reserve(std::size_t count){
+        first.reserve(count);
+        second.reserve(count);
+        length.reserve(count);
+        restitution.reserve(count);
+        rod.reserve(count);
+    }
+
+    void clear(){
+        first.clear();
+        second.clear();
+        length.clear();
+        restitution.clear();
+        rod.clear();
+        indexedCount = 0;
+    }
+
+    virtual void addContact(const ParticleStore &particles, ParticleContactArena &contacts){
+        const std::size_t count = first.size();
+        if (count == 0) return;
+
+        if (indexedVersion != particles.getLayoutVersion() || indexedCount != count){
+            firstIndex.resize(count);
+            secondIndex.resize(count);
+            for (std::size_t l = 0; l < count; l++){
+                firstIndex[l] = particles.indexOf(first[l]);
+                secondIndex[l] = particles.indexOf(second[l]);
+            }
+            indexedVersion = particles.getLayoutVersion();
+            indexedCount = count;
+        }
+
+        const real *px = particles.positions().x.data(), *py = particles.positions().y.data(), *pz = particles.positions().z.data();
+        separation.resize(count);
+        distance.resize(count);
+        real *sx = separation.x.data(), *sy = separation.y.data(), *sz = separation.z.data();
+        real *d = distance.data();
+        const unsigned *ia = firstIndex.data(), *ib = secondIndex.data();
+        for (std::size_t l = 0; l < count; l++){
+            sx[l] = px[ib[l]] - px[ia[l]];
+            sy[l] = py[ib[l]] - py[ia[l]];
+            sz[l] = pz[ib[l]] - pz[ia[l]];
+        }
+        for (std::size_t l = 0; l < count; l++){
+            d[l] = real_sqrt(sx[l]*sx[l] + sy[l]*sy[l] + sz[l]*sz[l]);
+        }
+
+        const unsigned awake = (unsigned)particles.getAwakeCount();
+        for (std::size_t l = 0; l < count; l++){
+            if (ia[l] >= awake && ib[l] >= awake) continue;
+            const real current = d[l];
+            real penetration;
+            real direction = 1;
+            if (rod[l]){
+                if (current == length[l]) continue;
+                if (current > length[l]){
+                    penetration = current - length[l];
+                }else{
+                    penetration = length[l] - current;
+                    direction = -1;
+                }
+            }else{
+                if (current < length[l]) continue;
+                penetration = current - length[l];
+            }
+
+            ParticleContact *contact = contacts.allocate();
+            if (!contact) return;
+            contact->particle[0] = first[l];
+            contact->particle[1] = second[l];
+            const real scale = current > 0 ? direction / current : 0;
+            contact->contactNormal = Vector3(sx[l] * scale, sy[l] * scale, sz[l] * scale);
+            contact->penetration = penetration;
+            contact->restitution = restitution[l];
+        }
+    }
+
+    protected:
+    unsigned add(ParticleHandle a, ParticleHandle b, real linkLength, real linkRestitution, bool isRod){
+        first.push_back(a);
+        second.push_back(b);
+        length.push_back(linkLength);
+        restitution.push_back(linkRestitution);
+        rod.push_back(isRod);
+        return (unsigned)(first.size() - 1);
+    }
+};
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+#include "math/vector_array.hpp"
+#include "structre/particle_force.hpp"
+#include "structre/particle_store.hpp"
+#include "structre/spatial_hash.hpp"
+#include <algorithm>
+#include <my.h>
+#include <vector>
+
+namespace my{
+/**
+ * The pair force used by blob-like cohesion: particles closer than
+ * minNaturalDistance push apart, particles between maxNaturalDistance
+ * and maxDistance pull together, and the band in between is neutral.
+ * Returns the force magnitude along the direction from the other
+ * particle, positive meaning repulsion.
+ */
+struct CohesionKernel{
+    real minNaturalDistance;
+    real maxNaturalDistance;
+    real maxDistance;
+    real maxRepulsion;
+    real maxAttraction;
+
+    real operator()(real distance) const{
+        if (distance < minNaturalDistance){
+            return distance / minNaturalDistance * maxRepulsion;
+        }
+        if (distance > maxNaturalDistance && distance < maxDistance){
+            return -(distance - maxNaturalDistance) / (maxDistance - maxNaturalDistance) * maxAttraction;
+        }
+        return 0;
+    }
+};
+
+/**
+ * Applies a short-range, distance-dependent pair force between all
+ * particles of the store that are closer than the cutoff radius.
+ *
+ * The kernel is called as kernel(distance) and returns the force
+ * magnitude along the separation, positive pushing the pair apart.
+ * Each pair is evaluated once per step and the equal and opposite
+ * forces are buffered in prepare, so updateForce(s) only add the
+ * buffered forces of the registered particles. Pairs of sleeping
+ * particles are skipped, and a sleeping registered particle pushed
+ * or pulled by an awake one is woken.
+ *
+ * Candidate pairs come from a Verlet neighbour list built from a
+ * spatial hash with radius cutoff + skin. The list is only rebuilt
+ * when some particle has moved more than skin / 2 since the last
+ * build, or particles were added or removed.
+ */
+template<class Kernel>
+class PairwiseForceGenerator : public ParticleForceGenerator{
+    protected:
+    real cutoff;
+    real skin;
+    Kernel kernel;
+
+    SpatialHash grid;
+    std::vector<unsigned> pairFirst;
+    std::vector<unsigned> pairSecond;
+    Vector3Array buildPosition;
+    Vector3Array force;
+    unsigned builtLayout = ~0u;
+    unsigned rebuilds = 0;
+
+    public:
+    PairwiseForceGenerator(real cutoff, real skin, const Kernel &kernel) : cutoff(cutoff), skin(skin), kernel(kernel){}
+
+    Kernel &getKernel(){
+        return kernel;
+    }
+
+    /**
+     * Returns how many times the neighbour list has been rebuilt.
+     */
+    unsigned getRebuildCount() const{
+        return rebuilds;
+    }
+
+    unsigned getPairCount() const{
+        return (unsigned)pairFirst.size();
+    }
+
+    virtual void prepare(ParticleStore &particles, real duration) override{
+        if (needsRebuild(particles)) rebuild(particles);
+
+        const unsigned pairs = (unsigned)pairFirst.size();
+        const real cutoffSquared = cutoff * cutoff;
+        const real *px = particles.positions().x.data();
+        const real *py = particles.positions().y.data();
+        const real *pz = particles.positions().z.data();
+
+        force.resize(particles.size());
+        force.fill(0);
+        real *fx = force.x.data(), *fy = force.y.data(), *fz = force.z.data();
+
+        const unsigned awake = (unsigned)particles.getAwakeCount();
+        for (unsigned k = 0; k < pairs; k++){
+            const unsigned i = pairFirst[k];
+            const unsigned j = pairSecond[k];
+            if (i >= awake && j >= awake) continue;
+            real rx = px[i] - px[j];
+            real ry = py[i] - py[j];
+            real rz = pz[i] - pz[j];
+            real distanceSquared = rx*rx + ry*ry + rz*rz;
+            if (distanceSquared >= cutoffSquared || distanceSquared <= 0) continue;
+
+            real distance = real_sqrt(distanceSquared);
+            real scale = kernel(distance) / distance;
+            if (scale == 0) continue;
+            rx *= scale; ry *= scale; rz *= scale;
+            fx[i] += rx; fy[i] += ry; fz[i] += rz;
+            fx[j] -= rx; fy[j] -= ry; fz[j] -= rz;
+        }
+    }
+
+    virtual void updateForce(ParticleStore &particles, ParticleHandle particle, real duration) override{
+        particles.addForce(particle, force.get(particles.indexOf(particle)));
+    }
+
+    virtual void updateForces(ParticleStore &particles, const ParticleHandle *handles, std::size_t count, real duration) override{
+        for (std::size_t i = 0; i < count; i++){
+            unsigned index = particles.indexOf(handles[i]);
+            particles.forceAccums().add(index, force.get(index));
+        }
+    }
+
+    virtual void updateSleepingForces(ParticleStore &particles, const ParticleHandle *handles, std::size_t count, real duration) override{
+        addBufferedForces(particles, force, handles, count);
+    }
+
+    protected:
+    bool needsRebuild(const ParticleStore &particles) const{
+        if (builtLayout != particles.getLayoutVersion()) return true;
+
+        const real limit = skin * skin * (real)0.25;
+        const std::size_t count = particles.size();
+        const real *px = particles.positions().x.data();
+        const real *py = particles.positions().y.data();
+        const real *pz = particles.positions().z.data();
+        const real *bx = buildPosition.x.data();
+        const real *by = buildPosition.y.data();
+        const real *bz = buildPosition.z.data();
+
+        // Check a block at a time, so a step that needs a rebuild
+        // stops at the first block with a particle that moved too far.
+        const std::size_t block = 256;
+        for (std::size_t begin = 0; begin < count; begin += block){
+            const std::size_t end = std::min(count, begin + block);
+            bool moved = false;
+            for (std::size_t i = begin; i < end; i++){
+                real dx = px[i] - bx[i];
+                real dy = py[i] - by[i];
+                real dz = pz[i] - bz[i];
+                moved |= (dx*dx + dy*dy + dz*dz > limit);
+            }
+            if (moved) return true;
+        }
+        return false;
+    }
+
+    void rebuild(const ParticleStore &particles){
+        const real radius = cutoff + skin;
+        buildPosition = particles.positions();
+        builtLayout = particles.getLayoutVersion();
+        rebuilds++;
+
+        pairFirst.clear();
+        pairSecond.clear();
+        grid.build(buildPosition, radius);
+        grid.forEachPair(radius, [&](unsigned i, unsigned j, real, real, real, real){
+            pairFirst.push_back(grid.originalIndex(i));
+            pairSecond.push_back(grid.originalIndex(j));
+            return true;
+        });
+    }
+};
+}
@@ -2,25 +2,29 @@
 
 #include "math/base.hpp"
 #include "math/precision.hpp"
+#include "math/vector_array.hpp"
 #include "structre/particle.hpp"
+#include "structre/particle_store.hpp"
+#include "structre/thread_pool.hpp"
+#include <cstddef>
 #include <memory>
 #include <my.h>
 #include <structre/particle_force.hpp>
+#include <vector>
 
 namespace my{
 class ParticleSpring : public ParticleForceGenerator{
-    std::shared_ptr<Particle> other;   
+    ParticleHandle other;
     real springConstant;
     real restLength;
     real minLength;
     real MaxLength;
     
     public:
-    ParticleSpring(std::shared_ptr<Particle> other, real springConstant, real restLength, real minLength = 0.0f, real MaxLength = REAL_MAX) : other(other), springConstant(springConstant), restLength(restLength), minLength(minLength), MaxLength(MaxLength) {}
-    virtual void updateForce(std::shared_ptr<Particle> particle, real duration) override{
-        Vector3 force;
-        particle->getPosition(&force);
-        force -= other->getPosition();
+    ParticleSpring(ParticleHandle other, real springConstant, real restLength, real minLength = 0.0f, real MaxLength = REAL_MAX) : other(other), springConstant(springConstant), restLength(restLength), minLength(minLength), MaxLength(MaxLength) {}
+    virtual void updateForce(ParticleStore &particles, ParticleHandle particle, real duration) override{
+        Vector3 force = particles.getPosition(particle);
+        force -= particles.getPosition(other);
 
         real magnitude = force.magnitude();
         if (magnitude <= minLength or magnitude >= MaxLength) return;
@@ -29,7 +33,7 @@ class ParticleSpring : public ParticleForceGenerator{
 
         force.normalize();
         force *= magnitude;
-        particle->addForce(force);
+        particles.addForce(particle, force);
     }
 };
 
@@ -40,21 +44,21 @@ class ParticleBuoyancy : public ParticleForceGenerator{
     real liquidDensity;
     
     public:
-    ParticleBuoyancy(real volume, real waterHeight, real maxDepth = REAL_MAX, real liquidDensity = 1000.0f) : maxDepth(maxDepth), volume(volume), waterHeight(waterHeight), liquidDensity(liquidDensity) {}
-    virtual void updateForce(std::shared_ptr<Particle> particle, real duration){
-        real depth = particle->getPosition().y;
+    ParticleBuoyancy(real volume, real waterHeight, real maxDepth = REAL_MAX, real liquidDensity = 1000.0f) : waterHeight(waterHeight), volume(volume), maxDepth(maxDepth), liquidDensity(liquidDensity) {}
+    virtual void updateForce(ParticleStore &particles, ParticleHandle particle, real duration){
+        real depth = particles.getPosition(particle).y;
         if (depth >= waterHeight ) return;
 
         Vector3 force(0,0,0);
 
         if (depth <= waterHeight - maxDepth){
             force.y = liquidDensity * volume;
-            particle->addForce(force);
+            particles.addForce(particle, force);
             return;
         }
 
         force.y = liquidDensity * volume * (waterHeight - depth - maxDepth ) / maxDepth;
-        particle->addForce(force);
+        particles.addForce(particle, force);
     } 
 };
 
@@ -65,25 +69,243 @@ class ParticleRealSpring : public ParticleForceGenerator{
 
     public:
     ParticleRealSpring(std::shared_ptr<Vector3> anchor, real springConstant, real damping) : anchor(anchor), springConstant(springConstant), damping(damping) {}
-    virtual void updateForce(std::shared_ptr<Particle> particle, real duration){
-        if (!particle->hasFiniteMass()) return;
+    virtual void updateForce(ParticleStore &particles, ParticleHandle particle, real duration){
+        if (!particles.hasFiniteMass(particle)) return;
 
-        Vector3 position;
-        particle->getPosition(&position);
+        Vector3 position = particles.getPosition(particle);
+        Vector3 velocity = particles.getVelocity(particle);
         position -= *anchor;
 
         real gamma = 0.5f * real_sqrt(4 * springConstant - damping*damping);
         if (gamma == 0.0f) return;
         Vector3 c = position * (damping / (2.0f * gamma)) +
-            particle->getVelocity() * (1.0f / gamma);
+            velocity * (1.0f / gamma);
 
         Vector3 target = position * real_cos(gamma * duration) +
             c * real_sin(gamma * duration);
         target *= real_exp(-0.5f * duration * damping);
 
         Vector3 accel = (target - position) * ((real)1.0 / (duration*duration)) -
-            particle->getVelocity() * ((real)1.0/duration);
-        particle->addForce(accel * particle->getMass());
+            velocity * ((real)1.0/duration);
+        particles.addForce(particle, accel * particles.getMass(particle));
+    }
+};
+
+/**
+ * Many springs between pairs of particles, stored as an edge list of
+ * handles with a rest length, stiffness and length range per spring.
+ * It behaves like a ParticleSpring at each end of every spring, but
+ * each spring is evaluated once per step and its equal and opposite
+ * forces are buffered in prepare. Register every particle that has
+ * springs once with the network, whatever its number of springs.
+ *
+ * Without a thread pool the springs add their forces straight into
+ * the buffer. With one, the springs are evaluated in parallel into a
+ * per-spring array, and each particle then sums the forces of its own
+ * springs, found through a compressed (CSR) list of the springs at
+ * each particle, so no two threads ever write the same element. Both
+ * ways sum each particle's forces in spring order and give the same
+ * result.
+ *
+ * Springs between two sleeping particles are skipped. A spring from
+ * an awake particle that pulls on a sleeping registered one wakes
+ * it.
+ */
+class SpringNetwork : public ParticleForceGenerator{
+    protected:
+    std::vector<ParticleHandle> first;
+    std::vector<ParticleHandle> second;
+    std::vector<real> springConstant;
+    std::vector<real> restLength;
+    std::vector<real> minLength;
+    std::vector<real> maxLength;
+    std::shared_ptr<ThreadPool> pool;
+    unsigned grain = 4096;
+
+    // Dense indices, rebuilt when the store's layout or the springs
+    // change, and the springs at each particle, only built for a pool
+    // with more than one thread.
+    std::vector<unsigned> firstIndex;
+    std::vector<unsigned> secondIndex;
+    std::vector<unsigned> springStart;
+    std::vector<unsigned> particleSprings;
+    std::vector<unsigned> nextSpring;
+    unsigned indexedVersion = ~0u;
+    std::size_t indexedCount = 0;
+    std::size_t indexedParticles = 0;
+    bool indexedSprings = false;
+
+    Vector3Array springForce;
+    Vector3Array force;
+
+    public:
+    /**
+     * Adds a spring between a and b, pulling or pushing them towards
+     * restLength apart while their distance is strictly between
+     * minLength and maxLength. Returns its index.
+     */
+    unsigned addSpring(ParticleHandle a, ParticleHandle b, real springConstant, real restLength, real minLength = 0.0f, real maxLength = REAL_MAX){
+        first.push_back(a);
+        second.push_back(b);
+        SpringNetwork::springConstant.push_back(springConstant);
+        SpringNetwork::restLength.push_back(restLength);
+        SpringNetwork::minLength.push_back(minLength);
+        SpringNetwork::maxLength.push_back(maxLength);
+        return (unsigned)(first.size() - 1);
+    }
+
+    std::size_t size() const{
+        return first.size();
+    }
+
+    void reserve(std::size_t count){
+        first.reserve(count);
+        second.reserve(count);
+        springConstant.reserve(count);
+        restLength.reserve(count);
+        minLength.reserve(count);
+        maxLength.reserve(count);
+    }
+
+    void clear(){
+        first.clear();
+        second.clear();
+        springConstant.clear();
+        restLength.clear();
+        minLength.clear();
+        maxLength.clear();
+        indexedCount = 0;
+    }
+
+    /**
+     * Sets the worker threads the springs are evaluated on, and the
+     * number of springs or particles each task takes. Null, the
+     * default, evaluates them on the calling thread.
+     */
+    void setThreadPool(std::shared_ptr<ThreadPool> pool, unsigned grain = 4096){
+        SpringNetwork::pool = pool;
+        SpringNetwork::grain = grain;
+    }
+
+    virtual void prepare(ParticleStore &particles, real duration) override{
+        const std::size_t count = first.size();
+        force.resize(particles.size());
+        force.fill(0);
+        if (count == 0) return;
+        const bool parallel = pool && pool->size() > 1;
+        if (indexedVersion != particles.getLayoutVersion() || indexedCount != count || indexedParticles != particles.size() ||
+            (parallel && !indexedSprings)){
+            index(particles, parallel);
+        }
+
+        const unsigned awake = (unsigned)particles.getAwakeCount();
+        if (!parallel){
+            real *fx = force.x.data(), *fy = force.y.data(), *fz = force.z.data();
+            for (std::size_t s = 0; s < count; s++){
+                const unsigned a = firstIndex[s], b = secondIndex[s];
+                if (a >= awake && b >= awake) continue;
+                real x, y, z;
+                if (!evaluate(particles, s, x, y, z)) continue;
+                fx[a] += x; fy[a] += y; fz[a] += z;
+                fx[b] -= x; fy[b] -= y; fz[b] -= z;
+            }
+            return;
+        }
+
+        springForce.resize(count);
+        pool->parallelFor((unsigned)count, [&](unsigned begin, unsigned end){
+            real *sx = springForce.x.data(), *sy = springForce.y.data(), *sz = springForce.z.data();
+            for (unsigned s = begin; s < end; s++){
+                sx[s] = sy[s] = sz[s] = 0;
+                if (firstIndex[s] >= awake && secondIndex[s] >= awake) continue;
+                evaluate(particles, s, sx[s], sy[s], sz[s]);
+            }
+        }, grain);
+        pool->parallelFor((unsigned)particles.size(), [&](unsigned begin, unsigned end){
+            const real *sx = springForce.x.data(), *sy = springForce.y.data(), *sz = springForce.z.data();
+            real *fx = force.x.data(), *fy = force.y.data(), *fz = force.z.data();
+            for (unsigned i = begin; i < end; i++){
+                real x = 0, y = 0, z = 0;
+                for (unsigned k = springStart[i]; k < springStart[i + 1]; k++){
+                    const unsigned s = particleSprings[k];
+                    if (firstIndex[s] == i){
+                        x += sx[s]; y += sy[s]; z += sz[s];
+                    }else{
+                        x -= sx[s]; y -= sy[s]; z -= sz[s];
+                    }
+                }
+                fx[i] = x; fy[i] = y; fz[i] = z;
+            }
+        }, grain);
+    }
+
+    virtual void updateForce(ParticleStore &particles, ParticleHandle particle, real duration) override{
+        particles.addForce(particle, force.get(particles.indexOf(particle)));
+    }
+
+    virtual void updateForces(ParticleStore &particles, const ParticleHandle *handles, std::size_t count, real duration) override{
+        for (std::size_t i = 0; i < count; i++){
+            unsigned index = particles.indexOf(handles[i]);
+            particles.forceAccums().add(index, force.get(index));
+        }
+    }
+
+    virtual void updateSleepingForces(ParticleStore &particles, const ParticleHandle *handles, std::size_t count, real duration) override{
+        addBufferedForces(particles, force, handles, count);
+    }
+
+    protected:
+    /**
+     * Computes the force of spring s on its first particle, as
+     * ParticleSpring would. Returns false when its length is outside
+     * its range.
+     */
+    bool evaluate(const ParticleStore &particles, std::size_t s, real &x, real &y, real &z) const{
+        const real *px = particles.positions().x.data(), *py = particles.positions().y.data(), *pz = particles.positions().z.data();
+        const unsigned a = firstIndex[s], b = secondIndex[s];
+        real dx = px[a] - px[b], dy = py[a] - py[b], dz = pz[a] - pz[b];
+        real length = real_sqrt(dx*dx + dy*dy + dz*dz);
+        if (length <= minLength[s] || length >= maxLength[s] || length <= 0) return false;
+
+        real scale = (restLength[s] - length) * springConstant[s] / length;
+        x = dx * scale; y = dy * scale; z = dz * scale;
+        return true;
+    }
+
+    /**
+     * Looks up the dense indices of every spring's ends and, when the
+     * springs are evaluated in parallel, the springs at each particle.
+     * All of it goes into members reused between calls.
+     */
+    void index(const ParticleStore &particles, bool springsAtParticles){
+        const std::size_t count = first.size();
+        const std::size_t n = particles.size();
+        firstIndex.resize(count);
+        secondIndex.resize(count);
+        for (std::size_t s = 0; s < count; s++){
+            firstIndex[s] = particles.indexOf(first[s]);
+            secondIndex[s] = particles.indexOf(second[s]);
+        }
+        indexedVersion = particles.getLayoutVersion();
+        indexedCount = count;
+        indexedParticles = n;
+        indexedSprings = springsAtParticles;
+        if (!springsAtParticles) return;
+
+        springStart.assign(n + 1, 0);
+        for (std::size_t s = 0; s < count; s++){
+            springStart[firstIndex[s] + 1]++;
+            springStart[secondIndex[s] + 1]++;
+        }
+        for (std::size_t i = 0; i < n; i++) springStart[i + 1] += springStart[i];
+
+        // Fill in spring order, so each particle's springs stay sorted.
+        particleSprings.resize(2 * count);
+        nextSpring.assign(springStart.begin(), springStart.end() - 1);
+        for (std::size_t s = 0; s < count; s++){
+            particleSprings[nextSpring[firstIndex[s]]++] = (unsigned)s;
+            particleSprings[nextSpring[secondIndex[s]]++] = (unsigned)s;
+        }
     }
 };
 }
@@ -0,0 +1,457 @@
+#pragma once
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+#include "math/vector_array.hpp"
+#include "structre/particle.hpp"
+#include <assert.h>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace my{
+/**
+ * Identifies a particle held in a ParticleStore. Handles stay valid
+ * until the particle is removed, even when other particles are
+ * removed and the storage is compacted.
+ */
+typedef unsigned ParticleHandle;
+
+/**
+ * Marks an unused particle slot, e.g. the second particle of a
+ * contact against the scenery.
+ */
+const ParticleHandle NO_PARTICLE = ~0u;
+
+/**
+ * Holds the state of many particles as a structure of arrays. Each
+ * property lives in its own contiguous array indexed by a dense
+ * index, and a handle table maps the stable handles handed out to
+ * callers onto those indices.
+ *
+ * Particles can be put to sleep. Awake particles always take the
+ * dense indices below getAwakeCount(), so passes that only concern
+ * moving particles run over that prefix. Sleeping or waking a
+ * particle moves it across the boundary and changes the layout
+ * version.
+ */
+class ParticleStore{
+    protected:
+    Vector3Array position;
+    Vector3Array velocity;
+    Vector3Array acceleration;
+    Vector3Array forceAccum;
+    std::vector<real> damping;
+    std::vector<real> inverseMass;
+    std::vector<real> motion;
+    std::size_t awakeCount = 0;
+    std::vector<ParticleHandle> pendingWakes;
+    bool deferringWakes = false;
+
+    std::vector<unsigned> handleToIndex;
+    std::vector<ParticleHandle> indexToHandle;
+    std::vector<ParticleHandle> freeHandles;
+    unsigned layoutVersion = 0;
+
+    public:
+    /**
+     * Copies the given particle into the store and returns the
+     * handle it can be reached by.
+     */
+    ParticleHandle add(const Particle &particle){
+        ParticleHandle handle;
+        if (freeHandles.empty()){
+            handle = (ParticleHandle)handleToIndex.size();
+            handleToIndex.push_back(0);
+        }else{
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+
+        handleToIndex[handle] = (unsigned)indexToHandle.size();
+        indexToHandle.push_back(handle);
+        layoutVersion++;
+
+        position.push_back(particle.getPosition());
+        velocity.push_back(particle.getVelocity());
+        acceleration.push_back(particle.getAcceleration());
+        forceAccum.push_back(particle.getForceAccum());
+        damping.push_back(particle.getDamping());
+        inverseMass.push_back(particle.getInverseMass());
+        motion.push_back(REAL_MAX);
+
+        if (awakeCount + 1 < size()) swapSlots(awakeCount, (unsigned)size() - 1);
+        awakeCount++;
+        return handle;
+    }
+
+    ParticleHandle add(){
+        return add(Particle());
+    }
+
+    /**
+     * Appends count copies of the given particle in one go. They take
+     * the dense indices from the old size() onwards.
+     */
+    void add(const Particle &particle, std::size_t count){
+        const std::size_t first = size();
+        const std::size_t total = first + count;
+        indexToHandle.resize(total);
+        for (std::size_t i = first; i < total; i++){
+            ParticleHandle handle;
+            if (freeHandles.empty()){
+                handle = (ParticleHandle)handleToIndex.size();
+                handleToIndex.push_back(0);
+            }else{
+                handle = freeHandles.back();
+                freeHandles.pop_back();
+            }
+            handleToIndex[handle] = (unsigned)i;
+            indexToHandle[i] = handle;
+        }
+        layoutVersion++;
+
+        Vector3Array *arrays[4] = {&position, &velocity, &acceleration, &forceAccum};
+        const Vector3 values[4] = {particle.getPosition(), particle.getVelocity(), particle.getAcceleration(), particle.getForceAccum()};
+        for (unsigned a = 0; a < 4; a++){
+            arrays[a]->x.resize(total, values[a].x);
+            arrays[a]->y.resize(total, values[a].y);
+            arrays[a]->z.resize(total, values[a].z);
+        }
+        damping.resize(total, particle.getDamping());
+        inverseMass.resize(total, particle.getInverseMass());
+        motion.resize(total, REAL_MAX);
+
+        for (std::size_t i = first; i < total; i++, awakeCount++){
+            if (awakeCount != i) swapSlots((unsigned)awakeCount, (unsigned)i);
+        }
+    }
+
+    /**
+     * Removes the particle, filling its slot with the last particle
+     * in the store. Other handles remain valid. While no particle is
+     * asleep, the other particles' dense indices change exactly as
+     * with Vector3Array::swapRemove.
+     */
+    void remove(ParticleHandle handle){
+        assert(contains(handle));
+        unsigned index = handleToIndex[handle];
+        if (index < awakeCount){
+            // Keep the awake particles in front by first swapping with
+            // the last awake particle when some are asleep.
+            awakeCount--;
+            if (awakeCount + 1 < size() && index != awakeCount){
+                swapSlots(index, (unsigned)awakeCount);
+                index = (unsigned)awakeCount;
+            }
+        }
+        ParticleHandle moved = indexToHandle.back();
+
+        position.swapRemove(index);
+        velocity.swapRemove(index);
+        acceleration.swapRemove(index);
+        forceAccum.swapRemove(index);
+        damping[index] = damping.back(); damping.pop_back();
+        inverseMass[index] = inverseMass.back(); inverseMass.pop_back();
+        motion[index] = motion.back(); motion.pop_back();
+        indexToHandle[index] = moved; indexToHandle.pop_back();
+
+        handleToIndex[moved] = index;
+        handleToIndex[handle] = NO_PARTICLE;
+        freeHandles.push_back(handle);
+        layoutVersion++;
+    }
+
+    void reserve(std::size_t count){
+        position.reserve(count);
+        velocity.reserve(count);
+        acceleration.reserve(count);
+        forceAccum.reserve(count);
+        damping.reserve(count);
+        inverseMass.reserve(count);
+        motion.reserve(count);
+        indexToHandle.reserve(count);
+        handleToIndex.reserve(count);
+    }
+
+    void clear(){
+        position.clear();
+        velocity.clear();
+        acceleration.clear();
+        forceAccum.clear();
+        damping.clear();
+        inverseMass.clear();
+        motion.clear();
+        awakeCount = 0;
+        handleToIndex.clear();
+        indexToHandle.clear();
+        freeHandles.clear();
+        layoutVersion++;
+    }
+
+    std::size_t size() const{
+        return indexToHandle.size();
+    }
+
+    bool contains(ParticleHandle handle) const{
+        return handle < handleToIndex.size() && handleToIndex[handle] != NO_PARTICLE;
+    }
+
+    unsigned indexOf(ParticleHandle handle) const{
+        return handleToIndex[handle];
+    }
+
+    ParticleHandle handleAt(unsigned index) const{
+        return indexToHandle[index];
+    }
+
+    /**
+     * Returns how many particles are awake. They hold the dense
+     * indices from zero up to this count.
+     */
+    std::size_t getAwakeCount() const{
+        return awakeCount;
+    }
+
+    bool isAwake(ParticleHandle handle) const{
+        return indexOf(handle) < awakeCount;
+    }
+
+    /**
+     * Wakes or sleeps the particle. A particle put to sleep loses its
+     * velocity and accumulated force. A woken particle's motion is
+     * reset high, so it is not put straight back to sleep.
+     */
+    void setAwake(ParticleHandle handle, bool awake){
+        unsigned index = indexOf(handle);
+        if (awake){
+            if (index < awakeCount) return;
+            motion[index] = REAL_MAX;
+            swapSlots(index, (unsigned)awakeCount);
+            awakeCount++;
+        }else{
+            if (index >= awakeCount) return;
+            velocity.set(index, Vector3());
+            forceAccum.set(index, Vector3());
+            awakeCount--;
+            swapSlots(index, (unsigned)awakeCount);
+        }
+    }
+
+    /**
+     * While set, addForce queues the particles it would wake instead
+     * of waking them, so that no particle changes slot during a pass
+     * that holds dense indices. Clearing it wakes the queued
+     * particles.
+     */
+    void deferWakes(bool defer){
+        deferringWakes = defer;
+        if (defer) return;
+        for (auto handle : pendingWakes){
+            if (contains(handle)) setAwake(handle, true);
+        }
+        pendingWakes.clear();
+    }
+
+    /**
+     * Changes whenever particles are added, removed, put to sleep or
+     * woken, i.e. whenever dense indices cached by other structures
+     * may have gone stale.
+     */
+    unsigned getLayoutVersion() const{
+        return layoutVersion;
+    }
+
+    /**
+     * Copies the particle back out of the store.
+     */
+    Particle get(ParticleHandle handle) const{
+        unsigned i = indexOf(handle);
+        Particle particle;
+        particle.setPosition(position.get(i));
+        particle.setVelocity(velocity.get(i));
+        particle.setAcceleration(acceleration.get(i));
+        particle.setForceAccum(forceAccum.get(i));
+        particle.setDamping(damping[i]);
+        particle.setInverseMass(inverseMass[i]);
+        return particle;
+    }
+
+    void setMass(ParticleHandle handle, const real mass){
+        assert(mass > 0.0);
+        inverseMass[indexOf(handle)] = ((real)1)/mass;
+    }
+
+    void setInverseMass(ParticleHandle handle, const real invMass){
+        inverseMass[indexOf(handle)] = invMass;
+    }
+
+    void setDamping(ParticleHandle handle, const real damp){
+        damping[indexOf(handle)] = damp;
+    }
+
+    void setPosition(ParticleHandle handle, const Vector3 &posi){
+        position.set(indexOf(handle), posi);
+    }
+
+    void setPosition(ParticleHandle handle, const real x, const real y, const real z){
+        position.set(indexOf(handle), Vector3(x, y, z));
+    }
+
+    void setVelocity(ParticleHandle handle, const Vector3 &velo){
+        velocity.set(indexOf(handle), velo);
+    }
+
+    void setVelocity(ParticleHandle handle, const real x, const real y, const real z){
+        velocity.set(indexOf(handle), Vector3(x, y, z));
+    }
+
+    void setAcceleration(ParticleHandle handle, const Vector3 &acce){
+        acceleration.set(indexOf(handle), acce);
+    }
+
+    void clearAccumulator(ParticleHandle handle){
+        forceAccum.set(indexOf(handle), Vector3());
+    }
+
+    void addVelocity(ParticleHandle handle, const Vector3 &velo){
+        velocity.add(indexOf(handle), velo);
+    }
+
+    /**
+     * Adds a force to the particle, waking it if it is asleep. Inside
+     * a force pass the wake waits for the end of the pass (see
+     * deferWakes), and the force moves with the particle's slot.
+     */
+    void addForce(ParticleHandle handle, const Vector3 &force){
+        if (!isAwake(handle)){
+            if (deferringWakes) pendingWakes.push_back(handle);
+            else setAwake(handle, true);
+        }
+        forceAccum.add(indexOf(handle), force);
+    }
+
+    Vector3 getPosition(ParticleHandle handle) const{
+        return position.get(indexOf(handle));
+    }
+
+    Vector3 getVelocity(ParticleHandle handle) const{
+        return velocity.get(indexOf(handle));
+    }
+
+    Vector3 getAcceleration(ParticleHandle handle) const{
+        return acceleration.get(indexOf(handle));
+    }
+
+    real getDamping(ParticleHandle handle) const{
+        return damping[indexOf(handle)];
+    }
+
+    real getInverseMass(ParticleHandle handle) const{
+        return inverseMass[indexOf(handle)];
+    }
+
+    bool hasFiniteMass(ParticleHandle handle) const{
+        return getInverseMass(handle) > 0.0f;
+    }
+
+    real getMass(ParticleHandle handle) const{
+        real invMass = getInverseMass(handle);
+        if (invMass > 0.0f){
+            return (real)1.0 / invMass;
+        }else{
+            return REAL_MAX;
+        }
+    }
+
+    /**
+     * Direct access to the arrays, indexed by dense index, for
+     * passes that touch every particle.
+     */
+    Vector3Array &positions() { return position; }
+    Vector3Array &velocities() { return velocity; }
+    Vector3Array &accelerations() { return acceleration; }
+    Vector3Array &forceAccums() { return forceAccum; }
+    std::vector<real> &dampings() { return damping; }
+    std::vector<real> &inverseMasses() { return inverseMass; }
+    std::vector<real> &motions() { return motion; }
+    const Vector3Array &positions() const { return position; }
+    const Vector3Array &velocities() const { return velocity; }
+    const Vector3Array &accelerations() const { return acceleration; }
+    const Vector3Array &forceAccums() const { return forceAccum; }
+    const std::vector<real> &dampings() const { return damping; }
+    const std::vector<real> &inverseMasses() const { return inverseMass; }
+    const std::vector<real> &motions() const { return motion; }
+
+    /**
+     * Zeroes the force accumulators of every particle.
+     */
+    void clearAccumulators(){
+        forceAccum.fill(0);
+    }
+
+    /**
+     * Integrates every awake particle forward by the given duration.
+     * This is the same update as Particle::integrate, run as one
+     * linear pass over the arrays.
+     */
+    void integrate(real duration){
+        integrateRange(0, awakeCount, duration);
+    }
+
+    /**
+     * Integrates the particles with dense indices in [begin, end).
+     * Particles usually share a handful of damping values, so the
+     * damping factor is only recomputed when it changes.
+     */
+    void integrateRange(std::size_t begin, std::size_t end, real duration){
+        assert(duration > 0.0);
+
+        real *px = position.x.data(), *py = position.y.data(), *pz = position.z.data();
+        real *vx = velocity.x.data(), *vy = velocity.y.data(), *vz = velocity.z.data();
+        const real *ax = acceleration.x.data(), *ay = acceleration.y.data(), *az = acceleration.z.data();
+        real *fx = forceAccum.x.data(), *fy = forceAccum.y.data(), *fz = forceAccum.z.data();
+        const real *damp = damping.data();
+        const real *invMass = inverseMass.data();
+
+        real lastDamping = -1;
+        real drag = 1;
+        for (std::size_t i = begin; i < end; i++){
+            px[i] += vx[i] * duration;
+            py[i] += vy[i] * duration;
+            pz[i] += vz[i] * duration;
+
+            if (damp[i] != lastDamping){
+                lastDamping = damp[i];
+                drag = real_pow(lastDamping, duration);
+            }
+            vx[i] = (vx[i] + (ax[i] + fx[i] * invMass[i]) * duration) * drag;
+            vy[i] = (vy[i] + (ay[i] + fy[i] * invMass[i]) * duration) * drag;
+            vz[i] = (vz[i] + (az[i] + fz[i] * invMass[i]) * duration) * drag;
+
+            fx[i] = fy[i] = fz[i] = 0;
+        }
+    }
+
+    protected:
+    /**
+     * Exchanges the dense slots of two particles.
+     */
+    void swapSlots(unsigned a, unsigned b){
+        if (a == b) return;
+        Vector3Array *arrays[4] = {&position, &velocity, &acceleration, &forceAccum};
+        for (auto array : arrays){
+            std::swap(array->x[a], array->x[b]);
+            std::swap(array->y[a], array->y[b]);
+            std::swap(array->z[a], array->z[b]);
+        }
+        std::swap(damping[a], damping[b]);
+        std::swap(inverseMass[a], inverseMass[b]);
+        std::swap(motion[a], motion[b]);
+        std::swap(indexToHandle[a], indexToHandle[b]);
+        handleToIndex[indexToHandle[a]] = a;
+        handleToIndex[indexToHandle[b]] = b;
+        layoutVersion++;
+    }
+};
+}
@@ -1,60 +1,176 @@
 #pragma once
 
 #include "structre/particle.hpp"
+#include "structre/particle_constraints.hpp"
 #include "structre/particle_force.hpp"
+#include "structre/particle_integrator.hpp"
+#include "structre/particle_store.hpp"
 #include "structre/pcontacts.hpp"
-#include <GL/gl.h>
+#include "structre/step_profiler.hpp"
+#include "structre/trace_recorder.hpp"
 #include <memory>
 #include <my.h>
+#include <typeinfo>
 #include <vector>
 
 namespace my {
 class ParticleWorld{
     protected:
     bool calculateIterations;
+    bool islandResolution = false;
+    real sleepEpsilon = 0;
     unsigned maxContacts;
-    std::vector<std::shared_ptr<ParticleContact>> contacts;
-    std::vector<std::shared_ptr<Particle>> particles;
+    ParticleContactArena contacts;
+    ParticleStore particles;
     std::vector<std::shared_ptr<ParticleContactGenerator>> contactGenerators;
     ParticleForceRegistry registry;
     ParticleContactResolver resolver;
+    ParticleIntegrator integrator;
+    std::shared_ptr<DistanceConstraintSolver> constraints;
+    std::shared_ptr<ThreadPool> pool;
+    std::shared_ptr<TraceRecorder> trace;
+    StepProfiler profiler;
 
     public:
-    ParticleWorld(unsigned maxContacts, unsigned iterations=0) : resolver(iterations), maxContacts(maxContacts){
-        contacts.reserve(maxContacts);
+    ParticleWorld(unsigned maxContacts, unsigned iterations=0) : maxContacts(maxContacts), contacts(maxContacts), resolver(iterations){
         calculateIterations = (iterations == 0);
     }
 
     void startFrame(){
-        for(auto particle : particles){
-            particle->clearAccumulator();
-        }
+        particles.clearAccumulators();
     }
 
     unsigned generateContacts(){
         auto cur_size = contacts.size();
-        for (auto contact_generator : contactGenerators){
-            contact_generator->addContact(contacts);
-            if (contacts.size() == contacts.capacity()) break;
+        for (const auto &contact_generator : contactGenerators){
+            TraceRecorder::Span span(trace.get(), typeid(*contact_generator).name(), "contacts", TraceRecorder::TYPE_NAME);
+            contact_generator->addContact(particles, contacts);
+            if (contacts.full()) break;
         }
         return contacts.size() - cur_size;
     }
 
     void integrate(real duration){
-        for (auto particle : particles){
-            particle->integrate(duration);
+        integrator.integrate(particles, duration);
+    }
+
+    /**
+     * Wakes the sleeping particles touched by an awake particle, then
+     * drops the contacts that still involve no awake movable particle.
+     * Returns how many contacts are left.
+     */
+    unsigned wakeTouched(){
+        for (auto &contact : contacts){
+            ParticleHandle a = contact.particle[0];
+            ParticleHandle b = contact.particle[1];
+            if (b == NO_PARTICLE) continue;
+            bool aAwake = particles.isAwake(a) && particles.hasFiniteMass(a);
+            bool bAwake = particles.isAwake(b) && particles.hasFiniteMass(b);
+            if (aAwake && !bAwake) particles.setAwake(b, true);
+            if (bAwake && !aAwake) particles.setAwake(a, true);
+        }
+
+        unsigned kept = 0;
+        for (auto &contact : contacts){
+            bool moving = false;
+            for (auto handle : contact.particle){
+                if (handle != NO_PARTICLE && particles.isAwake(handle) && particles.hasFiniteMass(handle)) moving = true;
+            }
+            if (moving) contacts[kept++] = contact;
+        }
+        contacts.truncate(kept);
+        return kept;
+    }
+
+    /**
+     * Updates the running average of each awake particle's squared
+     * speed and puts to sleep those that have come to rest. The
+     * average is capped so a fast particle that stops does not take
+     * long to fall asleep.
+     */
+    void updateMotion(real duration){
+        const real bias = real_pow((real)0.5, duration);
+        const real cap = 10 * sleepEpsilon;
+        const Vector3Array &v = particles.velocities();
+        std::vector<real> &motion = particles.motions();
+
+        // Walk down from the last awake particle, so a particle swapped
+        // in by putting another to sleep has already been updated.
+        for (std::size_t i = particles.getAwakeCount(); i-- > 0;){
+            real current = v.x[i]*v.x[i] + v.y[i]*v.y[i] + v.z[i]*v.z[i];
+            real average = bias * motion[i] + (1 - bias) * current;
+            if (average > cap) average = cap;
+            motion[i] = average;
+            if (average < sleepEpsilon) particles.setAwake(particles.handleAt((unsigned)i), false);
         }
     }
 
     void runPhysics(real duration){
-        registry.updateForces(duration);
-        integrate(duration);
-        unsigned used_contacts = generateContacts();
+#ifdef MY_PROFILE
+        StepProfile &frame = profiler.begin();
+        frame.particles = (unsigned)particles.size();
+        frame.awake = (unsigned)particles.getAwakeCount();
+#endif
+        TraceRecorder *recorder = trace.get();
+        TraceRecorder::Span stepSpan(recorder, "runPhysics", "step");
+        {
+            MY_PROFILE_PHASE(frame, FORCES);
+            TraceRecorder::Span span(recorder, "forces", "phase");
+            registry.updateForces(particles, duration);
+        }
+        MY_PROFILE_ONLY(frame.registrations = (unsigned)registry.getDispatchedCount());
+        {
+            MY_PROFILE_PHASE(frame, INTEGRATE);
+            TraceRecorder::Span span(recorder, "integrate", "phase");
+            integrate(duration);
+        }
+        if (constraints){
+            MY_PROFILE_PHASE(frame, CONSTRAINTS);
+            TraceRecorder::Span span(recorder, "constraints", "phase");
+            constraints->solve(particles, duration);
+        }
+        unsigned used_contacts;
+        {
+            MY_PROFILE_PHASE(frame, GENERATE_CONTACTS);
+            TraceRecorder::Span span(recorder, "contacts", "phase");
+            used_contacts = generateContacts();
+            if (particles.getAwakeCount() < particles.size()) used_contacts = wakeTouched();
+        }
+        MY_PROFILE_ONLY(frame.contacts = used_contacts);
         if (used_contacts){
-            if (calculateIterations) resolver.setIterations(used_contacts * 2);
-            resolver.resolveContacts(contacts, duration);
+            MY_PROFILE_PHASE(frame, RESOLVE_CONTACTS);
+            TraceRecorder::Span span(recorder, "resolve", "phase");
+            if (islandResolution){
+                resolver.resolveIslands(contacts.data(), contacts.size(), particles, duration, calculateIterations ? 2 : 0);
+            }else{
+                if (calculateIterations) resolver.setIterations(used_contacts * 2);
+                resolver.resolveContacts(contacts.data(), contacts.size(), particles, duration);
+            }
+            MY_PROFILE_ONLY(frame.iterations = resolver.getIterationsUsed());
         }
-        contacts.clear();
+        contacts.reset();
+        if (sleepEpsilon > 0) updateMotion(duration);
+    }
+
+    /**
+     * Puts particles to sleep once a running average of their squared
+     * speed stays below the given threshold. Sleeping particles are
+     * not integrated, get no forces from their own registrations and
+     * take no part in contacts until a contact with an awake
+     * particle, a spring or pair force from one, or a call to
+     * ParticleStore::addForce wakes them. Zero, the default, keeps
+     * every particle awake.
+     */
+    void setSleepThreshold(real epsilon){
+        sleepEpsilon = epsilon;
+    }
+
+    /**
+     * Adds a copy of the given particle to the world and returns the
+     * handle it is simulated under.
+     */
+    ParticleHandle addParticle(const Particle &particle){
+        return particles.add(particle);
     }
 
     auto getParticles(){
@@ -69,6 +185,74 @@ class ParticleWorld{
         return &registry;
     }
 
+    /**
+     * Selects the scalar or a vectorised integration path for the
+     * following calls to runPhysics.
+     */
+    void setIntegratorMode(ParticleIntegrator::Mode mode){
+        integrator.setMode(mode);
+    }
+
+    /**
+     * Selects how the contact resolver picks contacts. See
+     * ParticleContactResolver::Mode.
+     */
+    void setResolverMode(ParticleContactResolver::Mode mode){
+        resolver.setMode(mode);
+    }
+
+    /**
+     * Resolves the contacts of each island separately, with
+     * iterations for only its own contacts, instead of as one
+     * problem. Islands are resolved in parallel on the thread pool.
+     * See ParticleContactResolver::resolveIslands.
+     */
+    void setIslandResolution(bool enabled){
+        islandResolution = enabled;
+    }
+
+    /**
+     * Sets the solver whose distance constraints are projected after
+     * each integration, before contacts are generated. Null, the
+     * default, leaves that stage out.
+     */
+    void setConstraintSolver(std::shared_ptr<DistanceConstraintSolver> solver){
+        constraints = solver;
+    }
+
+    auto getConstraintSolver(){
+        return constraints.get();
+    }
+
+    /**
+     * Sets the worker threads used by parallel stages of the step.
+     */
+    void setThreadPool(std::shared_ptr<ThreadPool> pool){
+        ParticleWorld::pool = pool;
+        resolver.setThreadPool(pool);
+        if (pool) pool->setTraceRecorder(trace.get());
+    }
+
+    /**
+     * Records each step, its phases and its generators as spans, on
+     * the recorder and on the thread pool's workers. Null switches
+     * tracing off.
+     */
+    void setTraceRecorder(std::shared_ptr<TraceRecorder> recorder){
+        trace = recorder;
+        registry.setTraceRecorder(recorder.get());
+        if (pool) pool->setTraceRecorder(recorder.get());
+    }
+
+    /**
+     * Returns the profiles of the latest calls to runPhysics. Steps
+     * are only recorded when built with MY_PROFILE; otherwise it
+     * stays empty.
+     */
+    const StepProfiler &getProfiler() const{
+        return profiler;
+    }
+
 };
 
 }
\ No newline at end of file
@@ -3,8 +3,11 @@
 #include "math/base.hpp"
 #include "math/precision.hpp"
 #include "structre/particle.hpp"
+#include "structre/particle_store.hpp"
+#include "structre/thread_pool.hpp"
 #include <memory>
 #include <my.h>
+#include <utility>
 #include <vector>
 
 namespace my {
@@ -16,28 +19,53 @@ class ParticleContact{
     real restitution;
     real penetration;
     Vector3 contactNormal;
-    std::shared_ptr<Particle> particle[2];
+    ParticleHandle particle[2];
 
     protected:
-    void resolve(real duration){
-        resolveVelocity(duration);
-        resolveInterpenetration(duration);
+    /**
+     * Resolves velocity and interpenetration, and returns how far the
+     * particles were moved apart per unit of inverse mass (see
+     * resolveInterpenetration).
+     */
+    real resolve(ParticleStore &particles, real duration){
+        resolveVelocity(particles, duration);
+        return resolveInterpenetration(particles, duration);
     }
 
-    real calculateSeparatingVelocity() const{
-        Vector3 relativeVelocity = particle[0]->getVelocity();
-        if(particle[1]) relativeVelocity -= particle[1]->getVelocity();
+    /**
+     * Takes the movement of a particle this contact involves off its
+     * penetration.
+     */
+    void updatePenetration(ParticleHandle moved, const Vector3 &movement){
+        if (particle[0] == moved) penetration -= movement * contactNormal;
+        if (particle[1] == moved) penetration += movement * contactNormal;
+    }
+
+    real calculateSeparatingVelocity(const ParticleStore &particles) const{
+        Vector3 relativeVelocity = particles.getVelocity(particle[0]);
+        if(particle[1] != NO_PARTICLE) relativeVelocity -= particles.getVelocity(particle[1]);
         return relativeVelocity * contactNormal;
     }    
 
+    /**
+     * Returns the separating velocity if the contact still has
+     * something to resolve, closing or interpenetrating, and REAL_MAX
+     * otherwise.
+     */
+    real calculatePriority(const ParticleStore &particles) const{
+        real separatingVelocity = calculateSeparatingVelocity(particles);
+        if (separatingVelocity < 0 || penetration > 0) return separatingVelocity;
+        return REAL_MAX;
+    }
+
     private:
-    void resolveVelocity(real duration){
-        real separatingVelocity = calculateSeparatingVelocity();
+    void resolveVelocity(ParticleStore &particles, real duration){
+        real separatingVelocity = calculateSeparatingVelocity(particles);
         if (separatingVelocity > 0) return;
         
         real newSepVelocity = - separatingVelocity * restitution;
 
-        Vector3 accCausedVelocity = particle[0]->getAcceleration();
+        Vector3 accCausedVelocity = particles.getAcceleration(particle[0]);
         real accCausedSepVelocity = accCausedVelocity * contactNormal * duration;
         if (accCausedSepVelocity < 0){
             newSepVelocity += restitution * accCausedSepVelocity;
@@ -46,8 +74,8 @@ class ParticleContact{
 
         real deltaVelocity = newSepVelocity - separatingVelocity;
 
-        real totalInverseMass = particle[0]->getInverseMass();
-        if (particle[1]) totalInverseMass += particle[1]->getInverseMass();
+        real totalInverseMass = particles.getInverseMass(particle[0]);
+        if (particle[1] != NO_PARTICLE) totalInverseMass += particles.getInverseMass(particle[1]);
 
         if (totalInverseMass <= 0) return;
 
@@ -55,85 +83,613 @@ class ParticleContact{
 
         Vector3 impulsePerIMass = contactNormal * impulse;
 
-        particle[0]->setVelocity(particle[0]->getVelocity() + impulsePerIMass * particle[0]->getInverseMass());
-        if (particle[1]) {
-            particle[1]->setVelocity(particle[1]->getVelocity() + impulsePerIMass * -particle[1]->getInverseMass());
+        // Particles with infinite mass are never written, so contacts
+        // that only share such a particle can be resolved concurrently.
+        if (particles.hasFiniteMass(particle[0])){
+            particles.addVelocity(particle[0], impulsePerIMass * particles.getInverseMass(particle[0]));
+        }
+        if (particle[1] != NO_PARTICLE && particles.hasFiniteMass(particle[1])) {
+            particles.addVelocity(particle[1], impulsePerIMass * -particles.getInverseMass(particle[1]));
         }
     }
 
-    void resolveInterpenetration(real duration){
-        if (penetration <= 0) return;
+    /**
+     * Moves the particles apart along the normal, each in proportion
+     * to its inverse mass, so that together they cover the
+     * penetration. Returns the distance moved per unit of inverse
+     * mass, or zero if nothing moved. The penetration itself is left
+     * for the resolver to update.
+     */
+    real resolveInterpenetration(ParticleStore &particles, real duration){
+        if (penetration <= 0) return 0;
 
-        real totalInverseMass = particle[0]->getInverseMass();
-        if (particle[1]) totalInverseMass += particle[1]->getInverseMass();
+        real totalInverseMass = particles.getInverseMass(particle[0]);
+        if (particle[1] != NO_PARTICLE) totalInverseMass += particles.getInverseMass(particle[1]);
 
-        if (totalInverseMass <= 0) return;
+        if (totalInverseMass <= 0) return 0;
+
+        real move = penetration / totalInverseMass;
+        Vector3 movePerIMass = contactNormal * move;
+        if (particles.hasFiniteMass(particle[0])){
+            particles.setPosition(particle[0], particles.getPosition(particle[0]) + movePerIMass * particles.getInverseMass(particle[0]));
+        }
+        if (particle[1] != NO_PARTICLE && particles.hasFiniteMass(particle[1])){
+            particles.setPosition(particle[1], particles.getPosition(particle[1]) - movePerIMass * particles.getInverseMass(particle[1]));
+        }
+        return move;
+    }
+
+    /**
+     * Returns how far the resolved contact moved the particle on the
+     * given side, given the result of resolveInterpenetration.
+     */
+    Vector3 movement(const ParticleStore &particles, unsigned side, real move) const{
+        real scale = move * particles.getInverseMass(particle[side]);
+        return contactNormal * (side == 0 ? scale : -scale);
+    }
+};
+
+/**
+ * A per-frame bump allocator for contacts. Its storage is allocated
+ * once for the world's maximum number of contacts; contact generators
+ * take slots from it while generating and the world resets it at the
+ * end of each step, so no allocation happens in steady state.
+ */
+class ParticleContactArena{
+    protected:
+    std::unique_ptr<ParticleContact[]> storage;
+    unsigned capacity;
+    unsigned used;
+
+    public:
+    ParticleContactArena(unsigned capacity) : storage(new ParticleContact[capacity]), capacity(capacity), used(0){}
+
+    /**
+     * Returns the next free contact, or nullptr if the arena is full.
+     */
+    ParticleContact *allocate(){
+        if (used == capacity) return nullptr;
+        return &storage[used++];
+    }
+
+    void reset(){
+        used = 0;
+    }
+
+    bool full() const{
+        return used == capacity;
+    }
+
+    unsigned size() const{
+        return used;
+    }
+
+    unsigned getCapacity() const{
+        return capacity;
+    }
+
+    ParticleContact *data(){
+        return storage.get();
+    }
+
+    ParticleContact &operator[](unsigned i){
+        return storage[i];
+    }
+
+    ParticleContact *begin(){
+        return storage.get();
+    }
+
+    ParticleContact *end(){
+        return storage.get() + used;
+    }
+
+    /**
+     * Drops every contact from the given count on.
+     */
+    void truncate(unsigned count){
+        if (count < used) used = count;
+    }
+};
+
+/**
+ * Splits a step's contacts into islands: groups that share no movable
+ * particle with any other group, found with a union-find over the
+ * particles in contact. Particles with infinite mass do not join
+ * islands, so separate piles resting on the same ground stay apart.
+ * Contacts between two immovable particles belong to no island.
+ *
+ * Links such as rods and cables generate contacts like any other
+ * generator, so the particles they join share an island whenever the
+ * link is active.
+ */
+class ContactIslands{
+    protected:
+    std::vector<unsigned> parent;
+    std::vector<unsigned> rootIsland;
+    std::vector<unsigned> contactIsland;
+    std::vector<unsigned> islandStart;
+    std::vector<unsigned> order;
+
+    public:
+    /**
+     * Finds the islands of the given contacts. Returns how many there
+     * are.
+     */
+    unsigned build(const ParticleContact *contactArray, unsigned numContacts, const ParticleStore &particles){
+        const unsigned count = (unsigned)particles.size();
+        parent.resize(count);
+        for (unsigned i = 0; i < count; i++) parent[i] = i;
 
-        Vector3 movePerIMass = contactNormal * (penetration / totalInverseMass);
-        particle[0]->setPosition(particle[0]->getPosition() + movePerIMass * particle[0]->getInverseMass());
-        if (particle[1]){
-            particle[1]->setPosition(particle[1]->getPosition() - movePerIMass * particle[1]->getInverseMass());
+        for (unsigned c = 0; c < numContacts; c++){
+            unsigned a = movableIndex(contactArray[c], 0, particles);
+            unsigned b = movableIndex(contactArray[c], 1, particles);
+            if (a != NO_PARTICLE && b != NO_PARTICLE) unite(a, b);
+        }
+
+        // Number the islands in order of their first contact, then
+        // counting-sort the contacts by island.
+        rootIsland.assign(count, NO_PARTICLE);
+        contactIsland.resize(numContacts);
+        islandStart.assign(1, 0);
+        for (unsigned c = 0; c < numContacts; c++){
+            unsigned a = movableIndex(contactArray[c], 0, particles);
+            if (a == NO_PARTICLE) a = movableIndex(contactArray[c], 1, particles);
+            if (a == NO_PARTICLE){
+                contactIsland[c] = NO_PARTICLE;
+                continue;
+            }
+            unsigned root = find(a);
+            if (rootIsland[root] == NO_PARTICLE){
+                rootIsland[root] = (unsigned)islandStart.size() - 1;
+                islandStart.push_back(0);
+            }
+            contactIsland[c] = rootIsland[root];
+            islandStart[contactIsland[c] + 1]++;
+        }
+        for (unsigned i = 1; i < islandStart.size(); i++){
+            islandStart[i] += islandStart[i - 1];
         }
+
+        order.resize(islandStart.back());
+        rootIsland.assign(islandStart.begin(), islandStart.end() - 1);
+        for (unsigned c = 0; c < numContacts; c++){
+            if (contactIsland[c] != NO_PARTICLE) order[rootIsland[contactIsland[c]]++] = c;
+        }
+        return size();
+    }
+
+    unsigned size() const{
+        return (unsigned)islandStart.size() - 1;
+    }
+
+    /**
+     * The contacts of island i are contacts()[begin(i)] up to
+     * contacts()[end(i)], in their original order.
+     */
+    unsigned begin(unsigned island) const{
+        return islandStart[island];
+    }
+
+    unsigned end(unsigned island) const{
+        return islandStart[island + 1];
+    }
+
+    const unsigned *contacts() const{
+        return order.data();
+    }
+
+    /**
+     * Returns the island of the given contact, or NO_PARTICLE if it
+     * is in none. Only valid until the next build.
+     */
+    unsigned islandOf(unsigned contact) const{
+        return contactIsland[contact];
+    }
+
+    protected:
+    static unsigned movableIndex(const ParticleContact &contact, unsigned side, const ParticleStore &particles){
+        ParticleHandle handle = contact.particle[side];
+        if (handle == NO_PARTICLE || !particles.hasFiniteMass(handle)) return NO_PARTICLE;
+        return particles.indexOf(handle);
+    }
+
+    unsigned find(unsigned i){
+        while (parent[i] != i){
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    void unite(unsigned a, unsigned b){
+        a = find(a);
+        b = find(b);
+        if (a < b) parent[b] = a;
+        else if (b < a) parent[a] = b;
     }
 };
 
 class ParticleContactResolver{
+    public:
+    /**
+     * How the resolver picks the next contact to resolve. Both modes
+     * always resolve the contact with the most negative separating
+     * velocity (lowest index on ties) among those still closing or
+     * interpenetrating, so they resolve contacts in the same order,
+     * and stop early once no contact is left to resolve.
+     *
+     * LINEAR_SCAN rescans every contact each iteration. PRIORITY_QUEUE
+     * keeps contacts in an indexed min-heap and, after resolving one,
+     * only re-keys the contacts that share a movable particle with it.
+     * In both, the distance a contact moves its particles apart is
+     * taken off the penetration of every contact sharing them, itself
+     * included, so a contact picked again is not pushed apart twice.
+     *
+     * GRAPH_COLORED does not follow that order. It colours the contacts
+     * so that no two contacts of a colour share a movable particle, then
+     * sweeps the colours in order (Gauss-Seidel by colour), resolving
+     * the contacts of each colour in parallel on the thread pool. The
+     * iteration budget is spent in whole sweeps of every contact, and
+     * interpenetration is only resolved on the first sweep, since
+     * penetrations are not updated there: contacts of one colour share
+     * contacts of later colours, and would race to update them.
+     */
+    enum Mode{
+        LINEAR_SCAN = 0,
+        PRIORITY_QUEUE,
+        GRAPH_COLORED
+    };
+
+    /**
+     * Contacts beyond this many colours go into one extra batch that
+     * is resolved serially.
+     */
+    static const unsigned MAX_COLORS = 64;
+
     protected:
     unsigned iterations;
     unsigned iterationsUsed;
+    Mode mode;
+
+    // Scratch space for PRIORITY_QUEUE, kept between calls so that
+    // steady-state resolution does not allocate.
+    std::vector<unsigned> heap;
+    std::vector<unsigned> heapIndex;
+    std::vector<real> priority;
+    std::vector<unsigned> contactStart;
+    std::vector<unsigned> contactList;
+
+    // Scratch space for GRAPH_COLORED.
+    std::vector<unsigned long long> particleColors;
+    std::vector<unsigned> contactColor;
+    std::vector<unsigned> colorStart;
+    std::vector<unsigned> colorOrder;
+    std::shared_ptr<ThreadPool> pool;
+
+    // Scratch space for resolveIslands.
+    ContactIslands islands;
+    std::vector<unsigned> islandIterations;
 
     public:
-    ParticleContactResolver(unsigned iterations): iterations(iterations){}
+    ParticleContactResolver(unsigned iterations, Mode mode = LINEAR_SCAN): iterations(iterations), mode(mode){}
     void setIterations(unsigned iterations) {
         ParticleContactResolver::iterations = iterations;
     }
 
-    void resolveContacts(std::vector<std::shared_ptr<ParticleContact>> &contactArray, real duration){
+    void setMode(Mode mode){
+        ParticleContactResolver::mode = mode;
+    }
+
+    unsigned getIterationsUsed() const{
+        return iterationsUsed;
+    }
+
+    /**
+     * Sets the pool GRAPH_COLORED resolves each colour on. Without one
+     * the colours are still swept in order, on the calling thread.
+     */
+    void setThreadPool(std::shared_ptr<ThreadPool> pool){
+        ParticleContactResolver::pool = pool;
+    }
+
+    void resolveContacts(ParticleContact *contactArray, unsigned numContacts, ParticleStore &particles, real duration){
+        if (mode == PRIORITY_QUEUE){
+            resolveByPriority(contactArray, numContacts, particles, duration);
+            return;
+        }
+        if (mode == GRAPH_COLORED){
+            resolveByColor(contactArray, numContacts, particles, duration);
+            return;
+        }
+
         iterationsUsed = 0;
         while(iterationsUsed < iterations){
             auto max = REAL_MAX;
-            auto maxIndex = contactArray.size();
-            auto length = contactArray.size();
-            for (auto i = 0; i< length; i++){
-                real sepVel = contactArray[i]->calculateSeparatingVelocity();
+            auto maxIndex = numContacts;
+            for (unsigned i = 0; i < numContacts; i++){
+                real sepVel = contactArray[i].calculatePriority(particles);
                 if (sepVel < max){
                     max = sepVel;
                     maxIndex = i;
                 }
             }
-            contactArray[maxIndex]->resolve(duration);
+            if (maxIndex == numContacts) break;
+            ParticleContact &contact = contactArray[maxIndex];
+            real move = contact.resolve(particles, duration);
+            if (move != 0){
+                for (unsigned p = 0; p < 2; p++){
+                    ParticleHandle handle = contact.particle[p];
+                    if (handle == NO_PARTICLE || !particles.hasFiniteMass(handle)) continue;
+                    Vector3 movement = contact.movement(particles, p, move);
+                    for (unsigned i = 0; i < numContacts; i++) contactArray[i].updatePenetration(handle, movement);
+                }
+            }
             iterationsUsed ++;
         }
     }
 
+    /**
+     * Resolves each island of contacts on its own, in the same order
+     * as PRIORITY_QUEUE would within it, whatever the mode. Each
+     * island gets iterationsPerContact iterations for each of its
+     * contacts, or the fixed iteration count if iterationsPerContact
+     * is zero, so small islands do not pay for large ones. With a
+     * thread pool set, islands are resolved in parallel; the result
+     * does not depend on the number of threads.
+     */
+    void resolveIslands(ParticleContact *contactArray, unsigned numContacts, ParticleStore &particles, real duration, unsigned iterationsPerContact = 2){
+        iterationsUsed = 0;
+        if (numContacts == 0) return;
+
+        const unsigned count = islands.build(contactArray, numContacts, particles);
+        buildParticleContactLists(contactArray, numContacts, particles);
+
+        priority.resize(numContacts);
+        heapIndex.resize(numContacts);
+        heap.assign(islands.contacts(), islands.contacts() + islands.begin(count));
+        islandIterations.resize(count);
+
+        auto resolveRange = [&](unsigned from, unsigned to){
+            for (unsigned i = from; i < to; i++){
+                unsigned begin = islands.begin(i);
+                unsigned size = islands.end(i) - begin;
+                unsigned budget = iterationsPerContact ? iterationsPerContact * size : iterations;
+                islandIterations[i] = resolveHeap(contactArray, begin, size, budget, particles, duration);
+            }
+        };
+        if (pool){
+            pool->parallelFor(count, resolveRange, 16);
+        }else{
+            resolveRange(0, count);
+        }
+        for (unsigned i = 0; i < count; i++) iterationsUsed += islandIterations[i];
+    }
+
+    /**
+     * Returns the islands found by the last call to resolveIslands.
+     */
+    const ContactIslands &getIslands() const{
+        return islands;
+    }
+
+    protected:
+    void resolveByPriority(ParticleContact *contactArray, unsigned numContacts, ParticleStore &particles, real duration){
+        iterationsUsed = 0;
+        if (numContacts == 0) return;
+
+        buildParticleContactLists(contactArray, numContacts, particles);
+
+        priority.resize(numContacts);
+        heap.resize(numContacts);
+        heapIndex.resize(numContacts);
+        for (unsigned i = 0; i < numContacts; i++) heap[i] = i;
+        iterationsUsed = resolveHeap(contactArray, 0, numContacts, iterations, particles, duration);
+    }
+
+    /**
+     * Runs the priority-queue resolution over the contacts listed in
+     * heap[base] to heap[base + count], for the given number of
+     * iterations, and returns the number of iterations used. Every
+     * contact sharing a movable particle with one of them must be in
+     * the same range, so that disjoint ranges can be resolved at the
+     * same time.
+     */
+    unsigned resolveHeap(ParticleContact *contactArray, unsigned base, unsigned count, unsigned budget, ParticleStore &particles, real duration){
+        unsigned *slice = heap.data() + base;
+        for (unsigned i = 0; i < count; i++){
+            priority[slice[i]] = contactArray[slice[i]].calculatePriority(particles);
+            heapIndex[slice[i]] = i;
+        }
+        for (unsigned i = count / 2; i-- > 0;){
+            siftDown(slice, count, i);
+        }
+
+        unsigned used = 0;
+        for (; used < budget; used++){
+            if (count == 0 || priority[slice[0]] == REAL_MAX) break;
+            ParticleContact &contact = contactArray[slice[0]];
+            real move = contact.resolve(particles, duration);
+
+            for (unsigned p = 0; p < 2; p++){
+                ParticleHandle handle = contact.particle[p];
+                if (handle == NO_PARTICLE || !particles.hasFiniteMass(handle)) continue;
+                Vector3 movement = contact.movement(particles, p, move);
+                unsigned index = particles.indexOf(handle);
+                for (unsigned k = contactStart[index]; k < contactStart[index + 1]; k++){
+                    unsigned other = contactList[k];
+                    if (move != 0) contactArray[other].updatePenetration(handle, movement);
+                    priority[other] = contactArray[other].calculatePriority(particles);
+                    siftUp(slice, heapIndex[other]);
+                    siftDown(slice, count, heapIndex[other]);
+                }
+            }
+        }
+        return used;
+    }
+
+    void resolveByColor(ParticleContact *contactArray, unsigned numContacts, ParticleStore &particles, real duration){
+        iterationsUsed = 0;
+        if (numContacts == 0) return;
+
+        unsigned colors = colorContacts(contactArray, numContacts, particles);
+        unsigned sweeps = iterations / numContacts;
+        if (sweeps == 0) sweeps = 1;
+
+        for (unsigned sweep = 0; sweep < sweeps; sweep++){
+            bool first = (sweep == 0);
+            for (unsigned color = 0; color < colors; color++){
+                unsigned begin = colorStart[color];
+                unsigned count = colorStart[color + 1] - begin;
+                auto resolveRange = [&](unsigned from, unsigned to){
+                    for (unsigned k = from; k < to; k++){
+                        ParticleContact &contact = contactArray[colorOrder[begin + k]];
+                        contact.resolveVelocity(particles, duration);
+                        if (first) contact.resolveInterpenetration(particles, duration);
+                    }
+                };
+                if (pool && color < MAX_COLORS){
+                    pool->parallelFor(count, resolveRange, 256);
+                }else{
+                    resolveRange(0, count);
+                }
+            }
+            iterationsUsed += numContacts;
+        }
+    }
+
+    /**
+     * Greedily gives each contact the lowest colour not yet used by
+     * either of its movable particles, and orders the contacts by
+     * colour. Returns the number of colour batches.
+     */
+    unsigned colorContacts(ParticleContact *contactArray, unsigned numContacts, const ParticleStore &particles){
+        particleColors.assign(particles.size(), 0);
+        contactColor.resize(numContacts);
+        colorStart.assign(MAX_COLORS + 2, 0);
+
+        for (unsigned i = 0; i < numContacts; i++){
+            unsigned long long used = 0;
+            for (auto handle : contactArray[i].particle){
+                if (handle != NO_PARTICLE && particles.hasFiniteMass(handle)){
+                    used |= particleColors[particles.indexOf(handle)];
+                }
+            }
+
+            unsigned color = 0;
+            while (color < MAX_COLORS && (used >> color) & 1) color++;
+            if (color < MAX_COLORS){
+                for (auto handle : contactArray[i].particle){
+                    if (handle != NO_PARTICLE && particles.hasFiniteMass(handle)){
+                        particleColors[particles.indexOf(handle)] |= 1ull << color;
+                    }
+                }
+            }
+            contactColor[i] = color;
+            colorStart[color + 1]++;
+        }
+
+        unsigned colors = 0;
+        for (unsigned c = 1; c < colorStart.size(); c++){
+            if (colorStart[c]) colors = c;
+            colorStart[c] += colorStart[c - 1];
+        }
+
+        colorOrder.resize(numContacts);
+        contactStart.assign(colorStart.begin(), colorStart.end() - 1);
+        for (unsigned i = 0; i < numContacts; i++){
+            colorOrder[contactStart[contactColor[i]]++] = i;
+        }
+        return colors;
+    }
+
+    /**
+     * Builds, for every particle, the list of contacts it takes part
+     * in, as offsets into one flat array.
+     */
+    void buildParticleContactLists(ParticleContact *contactArray, unsigned numContacts, const ParticleStore &particles){
+        contactStart.assign(particles.size() + 1, 0);
+        for (unsigned i = 0; i < numContacts; i++){
+            for (auto handle : contactArray[i].particle){
+                if (handle != NO_PARTICLE) contactStart[particles.indexOf(handle) + 1]++;
+            }
+        }
+        for (unsigned i = 1; i < contactStart.size(); i++){
+            contactStart[i] += contactStart[i - 1];
+        }
+
+        contactList.resize(contactStart.back());
+        heapIndex.assign(contactStart.begin(), contactStart.end() - 1);
+        for (unsigned i = 0; i < numContacts; i++){
+            for (auto handle : contactArray[i].particle){
+                if (handle != NO_PARTICLE) contactList[heapIndex[particles.indexOf(handle)]++] = i;
+            }
+        }
+    }
+
+    bool before(unsigned a, unsigned b) const{
+        if (priority[a] != priority[b]) return priority[a] < priority[b];
+        return a < b;
+    }
+
+    void swapHeap(unsigned *slice, unsigned i, unsigned j){
+        std::swap(slice[i], slice[j]);
+        heapIndex[slice[i]] = i;
+        heapIndex[slice[j]] = j;
+    }
+
+    void siftUp(unsigned *slice, unsigned i){
+        while (i > 0){
+            unsigned parent = (i - 1) / 2;
+            if (!before(slice[i], slice[parent])) break;
+            swapHeap(slice, i, parent);
+            i = parent;
+        }
+    }
+
+    void siftDown(unsigned *slice, unsigned count, unsigned i){
+        while (true){
+            unsigned best = i;
+            unsigned left = 2 * i + 1;
+            unsigned right = left + 1;
+            if (left < count && before(slice[left], slice[best])) best = left;
+            if (right < count && before(slice[right], slice[best])) best = right;
+            if (best == i) break;
+            swapHeap(slice, i, best);
+            i = best;
+        }
+    }
 };
 
 class ParticleContactGenerator{
     public:
-    virtual void addContact(std::vector<std::shared_ptr<ParticleContact>> &contacts) = 0;
+    /**
+     * Writes any contacts into the arena, stopping when it is full.
+     */
+    virtual void addContact(const ParticleStore &particles, ParticleContactArena &contacts) = 0;
 };
 
 class GroundContacts : public ParticleContactGenerator{
-    std::vector<std::shared_ptr<Particle>> particles;
+    std::vector<ParticleHandle> particles;
 
     public:
-    void init(std::vector<std::shared_ptr<Particle>> &particles) {
-        particles = particles;
+    void init(const std::vector<ParticleHandle> &particles) {
+        GroundContacts::particles = particles;
     }
 
-    virtual void addContact(std::vector<std::shared_ptr<ParticleContact>> &contacts){
+    virtual void addContact(const ParticleStore &store, ParticleContactArena &contacts){
         for(auto particle : particles){
-            auto y = particle->getPosition().y;
+            if (!store.isAwake(particle)) continue;
+            auto y = store.getPosition(particle).y;
             if (y < 0.0f){
-                auto contact = std::make_shared<ParticleContact> ();
+                auto contact = contacts.allocate();
+                if (!contact) return;
                 contact->contactNormal = UP;
                 contact->particle[0] = particle;
-                contact->particle[1] = nullptr;
+                contact->particle[1] = NO_PARTICLE;
                 contact->penetration = -y;
                 contact->restitution = 0.2f;
-                contacts.push_back(contact);
             }
-            if (contacts.size() == contacts.capacity()) break;
         }
     }
 };
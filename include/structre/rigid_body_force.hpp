@@ -0,0 +1,94 @@
+#pragma once
+
+#include "structre/rigid_body_store.hpp"
+#include <cstddef>
+#include <memory>
+#include <my.h>
+#include <unordered_map>
+#include <vector>
+
+namespace my{
+class RigidBodyForceGenerator{
+    public:
+    virtual void updateForce(RigidBodyStore &bodies, RigidBodyHandle body, real duration) = 0;
+
+    /**
+     * Applies the force to every body in the batch. The default calls
+     * updateForce for each one.
+     */
+    virtual void updateForces(RigidBodyStore &bodies, const RigidBodyHandle *handles, std::size_t count, real duration){
+        for (std::size_t i = 0; i < count; i++){
+            updateForce(bodies, handles[i], duration);
+        }
+    }
+};
+
+/**
+ * Holds which force generators apply to which rigid bodies, grouped
+ * by generator like ParticleForceRegistry.
+ */
+class RigidBodyForceRegistry{
+    protected:
+    struct RigidBodyForceGroup{
+        std::shared_ptr<RigidBodyForceGenerator> fg;
+        std::vector<RigidBodyHandle> bodies;
+    };
+    std::vector<RigidBodyForceGroup> groups;
+    std::unordered_map<const RigidBodyForceGenerator*, std::size_t> groupIndex;
+    std::size_t registrationCount = 0;
+    std::vector<RigidBodyHandle> awake;
+
+    public:
+    void addRegistration(RigidBodyHandle body, std::shared_ptr<RigidBodyForceGenerator> fg){
+        registrationCount++;
+        auto found = groupIndex.find(fg.get());
+        if (found != groupIndex.end()){
+            groups[found->second].bodies.push_back(body);
+            return;
+        }
+        groupIndex[fg.get()] = groups.size();
+        RigidBodyForceGroup new_group;
+        new_group.fg = fg;
+        new_group.bodies.push_back(body);
+        groups.push_back(new_group);
+    }
+
+    void updateForces(RigidBodyStore &bodies, real duration){
+        const bool sleepers = bodies.getAwakeCount() < bodies.size();
+        for (const auto &group : groups){
+            if (!sleepers){
+                group.fg->updateForces(bodies, group.bodies.data(), group.bodies.size(), duration);
+                continue;
+            }
+
+            // Sleeping bodies get no forces until they are woken.
+            awake.clear();
+            for (auto handle : group.bodies){
+                if (bodies.isAwake(handle)) awake.push_back(handle);
+            }
+            group.fg->updateForces(bodies, awake.data(), awake.size(), duration);
+        }
+    }
+
+    std::size_t getRegistrationCount() const{
+        return registrationCount;
+    }
+
+    void clear(){
+        groups.clear();
+        groupIndex.clear();
+        registrationCount = 0;
+    }
+};
+
+class RigidBodyGravity : public RigidBodyForceGenerator{
+    Vector3 gravity;
+
+    public:
+    RigidBodyGravity(const Vector3 &grav) : gravity(grav){}
+    virtual void updateForce(RigidBodyStore &bodies, RigidBodyHandle body, real duration) override{
+        real invMass = bodies.getInverseMass(body);
+        if (invMass > 0.0f) bodies.addForce(body, gravity * ((real)1.0 / invMass));
+    }
+};
+}
@@ -0,0 +1,565 @@
+#pragma once
+
+#include "math/base.hpp"
+#include "math/precision.hpp"
+#include "math/vector_array.hpp"
+#include "structre/body.hpp"
+#include <assert.h>
+#include <cstddef>
+#include <vector>
+
+namespace my{
+/**
+ * Identifies a rigid body held in a RigidBodyStore. Like particle
+ * handles, they stay valid until the body is removed.
+ */
+typedef unsigned RigidBodyHandle;
+
+const RigidBodyHandle NO_BODY = ~0u;
+
+/**
+ * Holds the state of many rigid bodies as a structure of arrays, the
+ * way ParticleStore holds particles: every property, including each
+ * component of the orientations and matrices, lives in its own array
+ * indexed by a dense index, and handles map onto those indices.
+ *
+ * Awake bodies take the dense indices below getAwakeCount(), and the
+ * batched passes only run over those. Sleeping or waking a body moves
+ * it across the boundary and changes the layout version.
+ */
+class RigidBodyStore{
+    protected:
+    Vector3Array position;
+    Vector3Array velocity;
+    Vector3Array acceleration;
+    Vector3Array rotation;
+    Vector3Array forceAccum;
+    Vector3Array torqueAccum;
+    Vector3Array lastFrameAcceleration;
+    QuaternionArray orientation;
+    Matrix3Array inverseInertiaTensor;
+    Matrix3Array inverseInertiaTensorWorld;
+    Matrix4Array transform;
+    std::vector<real> inverseMass;
+    std::vector<real> linearDamping;
+    std::vector<real> angularDamping;
+    std::vector<real> motion;
+    std::vector<unsigned char> canSleep;
+    std::size_t awakeCount = 0;
+
+    std::vector<unsigned> handleToIndex;
+    std::vector<RigidBodyHandle> indexToHandle;
+    std::vector<RigidBodyHandle> freeHandles;
+    unsigned layoutVersion = 0;
+
+    public:
+    /**
+     * Copies the given body into the store, awake, and returns the
+     * handle it can be reached by. Its derived data is calculated on
+     * the way in.
+     */
+    RigidBodyHandle add(const RigidBody &body){
+        RigidBodyHandle handle;
+        if (freeHandles.empty()){
+            handle = (RigidBodyHandle)handleToIndex.size();
+            handleToIndex.push_back(0);
+        }else{
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+
+        const unsigned index = (unsigned)indexToHandle.size();
+        handleToIndex[handle] = index;
+        indexToHandle.push_back(handle);
+        layoutVersion++;
+
+        position.push_back(body.getPosition());
+        velocity.push_back(body.getVelocity());
+        acceleration.push_back(body.getAcceleration());
+        rotation.push_back(body.getRotation());
+        forceAccum.push_back(body.getForceAccum());
+        torqueAccum.push_back(body.getTorqueAccum());
+        lastFrameAcceleration.push_back(body.getLastFrameAcceleration());
+        orientation.push_back(body.getOrientation());
+        inverseInertiaTensor.push_back(body.getInverseInertiaTensor());
+        inverseInertiaTensorWorld.push_back(Matrix3());
+        transform.push_back(Matrix4());
+        inverseMass.push_back(body.getInverseMass());
+        linearDamping.push_back(body.getLinearDamping());
+        angularDamping.push_back(body.getAngularDamping());
+        motion.push_back(REAL_MAX);
+        canSleep.push_back(body.getCanSleep());
+        calculateDerivedData(index, index + 1);
+
+        if (awakeCount + 1 < size()) swapSlots(awakeCount, index);
+        awakeCount++;
+        return handle;
+    }
+
+    /**
+     * Removes the body, filling its slot with another. Other handles
+     * remain valid.
+     */
+    void remove(RigidBodyHandle handle){
+        assert(contains(handle));
+        unsigned index = handleToIndex[handle];
+        if (index < awakeCount){
+            awakeCount--;
+            if (awakeCount + 1 < size() && index != awakeCount){
+                swapSlots(index, (unsigned)awakeCount);
+                index = (unsigned)awakeCount;
+            }
+        }
+        RigidBodyHandle moved = indexToHandle.back();
+
+        position.swapRemove(index);
+        velocity.swapRemove(index);
+        acceleration.swapRemove(index);
+        rotation.swapRemove(index);
+        forceAccum.swapRemove(index);
+        torqueAccum.swapRemove(index);
+        lastFrameAcceleration.swapRemove(index);
+        orientation.swapRemove(index);
+        inverseInertiaTensor.swapRemove(index);
+        inverseInertiaTensorWorld.swapRemove(index);
+        transform.swapRemove(index);
+        inverseMass[index] = inverseMass.back(); inverseMass.pop_back();
+        linearDamping[index] = linearDamping.back(); linearDamping.pop_back();
+        angularDamping[index] = angularDamping.back(); angularDamping.pop_back();
+        motion[index] = motion.back(); motion.pop_back();
+        canSleep[index] = canSleep.back(); canSleep.pop_back();
+        indexToHandle[index] = moved; indexToHandle.pop_back();
+
+        handleToIndex[moved] = index;
+        handleToIndex[handle] = NO_BODY;
+        freeHandles.push_back(handle);
+        layoutVersion++;
+    }
+
+    void reserve(std::size_t count){
+        Vector3Array *vectors[7] = {&position, &velocity, &acceleration, &rotation, &forceAccum, &torqueAccum, &lastFrameAcceleration};
+        for (auto array : vectors) array->reserve(count);
+        orientation.reserve(count);
+        inverseInertiaTensor.reserve(count);
+        inverseInertiaTensorWorld.reserve(count);
+        transform.reserve(count);
+        inverseMass.reserve(count);
+        linearDamping.reserve(count);
+        angularDamping.reserve(count);
+        motion.reserve(count);
+        canSleep.reserve(count);
+        indexToHandle.reserve(count);
+        handleToIndex.reserve(count);
+    }
+
+    void clear(){
+        Vector3Array *vectors[7] = {&position, &velocity, &acceleration, &rotation, &forceAccum, &torqueAccum, &lastFrameAcceleration};
+        for (auto array : vectors) array->clear();
+        orientation.clear();
+        inverseInertiaTensor.clear();
+        inverseInertiaTensorWorld.clear();
+        transform.clear();
+        inverseMass.clear();
+        linearDamping.clear();
+        angularDamping.clear();
+        motion.clear();
+        canSleep.clear();
+        awakeCount = 0;
+        handleToIndex.clear();
+        indexToHandle.clear();
+        freeHandles.clear();
+        layoutVersion++;
+    }
+
+    std::size_t size() const{
+        return indexToHandle.size();
+    }
+
+    bool contains(RigidBodyHandle handle) const{
+        return handle < handleToIndex.size() && handleToIndex[handle] != NO_BODY;
+    }
+
+    unsigned indexOf(RigidBodyHandle handle) const{
+        return handleToIndex[handle];
+    }
+
+    RigidBodyHandle handleAt(unsigned index) const{
+        return indexToHandle[index];
+    }
+
+    unsigned getLayoutVersion() const{
+        return layoutVersion;
+    }
+
+    std::size_t getAwakeCount() const{
+        return awakeCount;
+    }
+
+    bool isAwake(RigidBodyHandle handle) const{
+        return indexOf(handle) < awakeCount;
+    }
+
+    /**
+     * Wakes or sleeps the body. A body put to sleep loses its
+     * velocity, rotation and accumulated force and torque.
+     */
+    void setAwake(RigidBodyHandle handle, bool awake){
+        unsigned index = indexOf(handle);
+        if (awake){
+            if (index < awakeCount) return;
+            motion[index] = REAL_MAX;
+            swapSlots(index, (unsigned)awakeCount);
+            awakeCount++;
+        }else{
+            if (index >= awakeCount) return;
+            velocity.set(index, Vector3());
+            rotation.set(index, Vector3());
+            forceAccum.set(index, Vector3());
+            torqueAccum.set(index, Vector3());
+            awakeCount--;
+            swapSlots(index, (unsigned)awakeCount);
+        }
+    }
+
+    /**
+     * Bodies that cannot sleep are woken if asleep and kept awake.
+     */
+    void setCanSleep(RigidBodyHandle handle, bool canSleep){
+        RigidBodyStore::canSleep[indexOf(handle)] = canSleep;
+        if (!canSleep) setAwake(handle, true);
+    }
+
+    bool getCanSleep(RigidBodyHandle handle) const{
+        return canSleep[indexOf(handle)] != 0;
+    }
+
+    /**
+     * Copies the body back out of the store.
+     */
+    RigidBody get(RigidBodyHandle handle) const{
+        unsigned i = indexOf(handle);
+        RigidBody body;
+        body.setPosition(position.get(i));
+        body.setVelocity(velocity.get(i));
+        body.setAcceleration(acceleration.get(i));
+        body.setRotation(rotation.get(i));
+        body.setOrientation(orientation.get(i));
+        body.setInverseInertiaTensor(inverseInertiaTensor.get(i));
+        body.setInverseMass(inverseMass[i]);
+        body.setDamping(linearDamping[i], angularDamping[i]);
+        body.setCanSleep(canSleep[i] != 0);
+        body.calculateDerivedData();
+        body.setForceAccum(forceAccum.get(i));
+        body.setTorqueAccum(torqueAccum.get(i));
+        if (i >= awakeCount) body.setAwake(false);
+        return body;
+    }
+
+    void setPosition(RigidBodyHandle handle, const Vector3 &posi){
+        position.set(indexOf(handle), posi);
+    }
+
+    void setVelocity(RigidBodyHandle handle, const Vector3 &velo){
+        velocity.set(indexOf(handle), velo);
+    }
+
+    void setAcceleration(RigidBodyHandle handle, const Vector3 &acce){
+        acceleration.set(indexOf(handle), acce);
+    }
+
+    void setRotation(RigidBodyHandle handle, const Vector3 &rota){
+        rotation.set(indexOf(handle), rota);
+    }
+
+    void setOrientation(RigidBodyHandle handle, const Quaternion &q){
+        Quaternion unit = q;
+        unit.normalise();
+        orientation.set(indexOf(handle), unit);
+    }
+
+    void setMass(RigidBodyHandle handle, const real mass){
+        assert(mass > 0.0);
+        inverseMass[indexOf(handle)] = ((real)1)/mass;
+    }
+
+    void setInertiaTensor(RigidBodyHandle handle, const Matrix3 &inertiaTensor){
+        Matrix3 inverse;
+        inverse.setInverse(inertiaTensor);
+        inverseInertiaTensor.set(indexOf(handle), inverse);
+    }
+
+    /**
+     * Adds a force at the body's centre of mass, waking it if it is
+     * asleep.
+     */
+    void addForce(RigidBodyHandle handle, const Vector3 &force){
+        if (!isAwake(handle)) setAwake(handle, true);
+        forceAccum.add(indexOf(handle), force);
+    }
+
+    /**
+     * Adds a world-space torque, waking the body if it is asleep.
+     */
+    void addTorque(RigidBodyHandle handle, const Vector3 &torque){
+        if (!isAwake(handle)) setAwake(handle, true);
+        torqueAccum.add(indexOf(handle), torque);
+    }
+
+    /**
+     * Adds a force applied at the given world-space point.
+     */
+    void addForceAtPoint(RigidBodyHandle handle, const Vector3 &force, const Vector3 &point){
+        Vector3 arm = point - getPosition(handle);
+        addForce(handle, force);
+        torqueAccum.add(indexOf(handle), arm % force);
+    }
+
+    Vector3 getPosition(RigidBodyHandle handle) const{
+        return position.get(indexOf(handle));
+    }
+
+    Vector3 getVelocity(RigidBodyHandle handle) const{
+        return velocity.get(indexOf(handle));
+    }
+
+    Vector3 getRotation(RigidBodyHandle handle) const{
+        return rotation.get(indexOf(handle));
+    }
+
+    Quaternion getOrientation(RigidBodyHandle handle) const{
+        return orientation.get(indexOf(handle));
+    }
+
+    Matrix4 getTransform(RigidBodyHandle handle) const{
+        return transform.get(indexOf(handle));
+    }
+
+    Matrix3 getInverseInertiaTensorWorld(RigidBodyHandle handle) const{
+        return inverseInertiaTensorWorld.get(indexOf(handle));
+    }
+
+    real getInverseMass(RigidBodyHandle handle) const{
+        return inverseMass[indexOf(handle)];
+    }
+
+    /**
+     * Direct access to the arrays, indexed by dense index, for
+     * passes that touch every body.
+     */
+    Vector3Array &positions() { return position; }
+    Vector3Array &velocities() { return velocity; }
+    Vector3Array &rotations() { return rotation; }
+    Vector3Array &forceAccums() { return forceAccum; }
+    Vector3Array &torqueAccums() { return torqueAccum; }
+    QuaternionArray &orientations() { return orientation; }
+    Matrix3Array &inverseInertiaTensors() { return inverseInertiaTensor; }
+    Matrix3Array &inverseInertiaTensorsWorld() { return inverseInertiaTensorWorld; }
+    Matrix4Array &transforms() { return transform; }
+    std::vector<real> &motions() { return motion; }
+    const Vector3Array &positions() const { return position; }
+    const Vector3Array &velocities() const { return velocity; }
+    const Vector3Array &rotations() const { return rotation; }
+    const Vector3Array &forceAccums() const { return forceAccum; }
+    const Vector3Array &torqueAccums() const { return torqueAccum; }
+    const QuaternionArray &orientations() const { return orientation; }
+    const Matrix3Array &inverseInertiaTensors() const { return inverseInertiaTensor; }
+    const Matrix3Array &inverseInertiaTensorsWorld() const { return inverseInertiaTensorWorld; }
+    const Matrix4Array &transforms() const { return transform; }
+    const std::vector<real> &motions() const { return motion; }
+    const std::vector<unsigned char> &canSleeps() const { return canSleep; }
+
+    /**
+     * Zeroes the force and torque accumulators of every body.
+     */
+    void clearAccumulators(){
+        forceAccum.fill(0);
+        torqueAccum.fill(0);
+    }
+
+    /**
+     * Integrates every awake body forward by the given duration, with
+     * the same update as RigidBody::integrate, then recalculates
+     * their derived data.
+     */
+    void integrate(real duration){
+        integrateRange(0, awakeCount, duration);
+        calculateDerivedData(0, awakeCount);
+    }
+
+    /**
+     * Updates the velocities, positions and orientations of the
+     * bodies with dense indices in [begin, end) and clears their
+     * accumulators. Their derived data is left stale.
+     */
+    void integrateRange(std::size_t begin, std::size_t end, real duration){
+        assert(duration > 0.0);
+
+        real *px = position.x.data(), *py = position.y.data(), *pz = position.z.data();
+        real *vx = velocity.x.data(), *vy = velocity.y.data(), *vz = velocity.z.data();
+        real *wx = rotation.x.data(), *wy = rotation.y.data(), *wz = rotation.z.data();
+        const real *ax = acceleration.x.data(), *ay = acceleration.y.data(), *az = acceleration.z.data();
+        real *fx = forceAccum.x.data(), *fy = forceAccum.y.data(), *fz = forceAccum.z.data();
+        real *tx = torqueAccum.x.data(), *ty = torqueAccum.y.data(), *tz = torqueAccum.z.data();
+        real *lx = lastFrameAcceleration.x.data(), *ly = lastFrameAcceleration.y.data(), *lz = lastFrameAcceleration.z.data();
+        real *qr = orientation.c[0].data(), *qi = orientation.c[1].data(), *qj = orientation.c[2].data(), *qk = orientation.c[3].data();
+        const real *m[9];
+        for (unsigned k = 0; k < 9; k++) m[k] = inverseInertiaTensorWorld.c[k].data();
+        const real *invMass = inverseMass.data();
+        const real *linear = linearDamping.data();
+        const real *angular = angularDamping.data();
+
+        real lastLinear = -1, lastAngular = -1;
+        real linearDrag = 1, angularDrag = 1;
+        const real halfDuration = duration * (real)0.5;
+        for (std::size_t i = begin; i < end; i++){
+            if (linear[i] != lastLinear){
+                lastLinear = linear[i];
+                linearDrag = real_pow(lastLinear, duration);
+            }
+            if (angular[i] != lastAngular){
+                lastAngular = angular[i];
+                angularDrag = real_pow(lastAngular, duration);
+            }
+
+            lx[i] = ax[i] + fx[i] * invMass[i];
+            ly[i] = ay[i] + fy[i] * invMass[i];
+            lz[i] = az[i] + fz[i] * invMass[i];
+            real alphaX = m[0][i]*tx[i] + m[1][i]*ty[i] + m[2][i]*tz[i];
+            real alphaY = m[3][i]*tx[i] + m[4][i]*ty[i] + m[5][i]*tz[i];
+            real alphaZ = m[6][i]*tx[i] + m[7][i]*ty[i] + m[8][i]*tz[i];
+
+            vx[i] = (vx[i] + lx[i] * duration) * linearDrag;
+            vy[i] = (vy[i] + ly[i] * duration) * linearDrag;
+            vz[i] = (vz[i] + lz[i] * duration) * linearDrag;
+            wx[i] = (wx[i] + alphaX * duration) * angularDrag;
+            wy[i] = (wy[i] + alphaY * duration) * angularDrag;
+            wz[i] = (wz[i] + alphaZ * duration) * angularDrag;
+
+            px[i] += vx[i] * duration;
+            py[i] += vy[i] * duration;
+            pz[i] += vz[i] * duration;
+
+            // q += (0, w) q * duration / 2
+            real r = qr[i], a = qi[i], b = qj[i], c = qk[i];
+            qr[i] = r + (-wx[i]*a - wy[i]*b - wz[i]*c) * halfDuration;
+            qi[i] = a + ( wx[i]*r + wy[i]*c - wz[i]*b) * halfDuration;
+            qj[i] = b + ( wy[i]*r + wz[i]*a - wx[i]*c) * halfDuration;
+            qk[i] = c + ( wz[i]*r + wx[i]*b - wy[i]*a) * halfDuration;
+
+            fx[i] = fy[i] = fz[i] = 0;
+            tx[i] = ty[i] = tz[i] = 0;
+        }
+    }
+
+    /**
+     * Normalises the orientations of the bodies with dense indices in
+     * [begin, end) and recalculates their transforms and world-space
+     * inverse inertia tensors.
+     */
+    void calculateDerivedData(std::size_t begin, std::size_t end){
+        calculateTransforms(begin, end);
+        transformInertiaTensors(begin, end);
+    }
+
+    /**
+     * Normalises the orientations and rebuilds the transform matrices
+     * of the bodies with dense indices in [begin, end), with the
+     * formula of RigidBody::_calculateTransformMatrix.
+     */
+    void calculateTransforms(std::size_t begin, std::size_t end){
+        real *qr = orientation.c[0].data(), *qi = orientation.c[1].data(), *qj = orientation.c[2].data(), *qk = orientation.c[3].data();
+        const real *px = position.x.data(), *py = position.y.data(), *pz = position.z.data();
+        real *t[12];
+        for (unsigned k = 0; k < 12; k++) t[k] = transform.c[k].data();
+
+        for (std::size_t i = begin; i < end; i++){
+            real d = qr[i]*qr[i] + qi[i]*qi[i] + qj[i]*qj[i] + qk[i]*qk[i];
+            if (d < real_epsilon){
+                qr[i] = 1;
+            }else{
+                d = ((real)1.0)/real_sqrt(d);
+                qr[i] *= d; qi[i] *= d; qj[i] *= d; qk[i] *= d;
+            }
+            const real r = qr[i], a = qi[i], b = qj[i], c = qk[i];
+
+            t[0][i] = 1 - 2*b*b - 2*c*c;
+            t[1][i] = 2*a*b - 2*r*c;
+            t[2][i] = 2*a*c + 2*r*b;
+            t[3][i] = px[i];
+            t[4][i] = 2*a*b + 2*r*c;
+            t[5][i] = 1 - 2*a*a - 2*c*c;
+            t[6][i] = 2*b*c - 2*r*a;
+            t[7][i] = py[i];
+            t[8][i] = 2*a*c - 2*r*b;
+            t[9][i] = 2*b*c + 2*r*a;
+            t[10][i] = 1 - 2*a*a - 2*b*b;
+            t[11][i] = pz[i];
+        }
+    }
+
+    /**
+     * Sets the world-space inverse inertia tensors of the bodies with
+     * dense indices in [begin, end) to R * I^-1 * R^T, where R is the
+     * rotation part of the transform, as RigidBody::
+     * _transformInertiaTensor does.
+     */
+    void transformInertiaTensors(std::size_t begin, std::size_t end){
+        const real *t[12], *b[9];
+        real *w[9];
+        for (unsigned k = 0; k < 12; k++) t[k] = transform.c[k].data();
+        for (unsigned k = 0; k < 9; k++){
+            b[k] = inverseInertiaTensor.c[k].data();
+            w[k] = inverseInertiaTensorWorld.c[k].data();
+        }
+
+        for (std::size_t i = begin; i < end; i++){
+            real t4 = t[0][i]*b[0][i] + t[1][i]*b[3][i] + t[2][i]*b[6][i];
+            real t9 = t[0][i]*b[1][i] + t[1][i]*b[4][i] + t[2][i]*b[7][i];
+            real t14 = t[0][i]*b[2][i] + t[1][i]*b[5][i] + t[2][i]*b[8][i];
+            real t28 = t[4][i]*b[0][i] + t[5][i]*b[3][i] + t[6][i]*b[6][i];
+            real t33 = t[4][i]*b[1][i] + t[5][i]*b[4][i] + t[6][i]*b[7][i];
+            real t38 = t[4][i]*b[2][i] + t[5][i]*b[5][i] + t[6][i]*b[8][i];
+            real t52 = t[8][i]*b[0][i] + t[9][i]*b[3][i] + t[10][i]*b[6][i];
+            real t57 = t[8][i]*b[1][i] + t[9][i]*b[4][i] + t[10][i]*b[7][i];
+            real t62 = t[8][i]*b[2][i] + t[9][i]*b[5][i] + t[10][i]*b[8][i];
+
+            w[0][i] = t4*t[0][i] + t9*t[1][i] + t14*t[2][i];
+            w[1][i] = t4*t[4][i] + t9*t[5][i] + t14*t[6][i];
+            w[2][i] = t4*t[8][i] + t9*t[9][i] + t14*t[10][i];
+            w[3][i] = t28*t[0][i] + t33*t[1][i] + t38*t[2][i];
+            w[4][i] = t28*t[4][i] + t33*t[5][i] + t38*t[6][i];
+            w[5][i] = t28*t[8][i] + t33*t[9][i] + t38*t[10][i];
+            w[6][i] = t52*t[0][i] + t57*t[1][i] + t62*t[2][i];
+            w[7][i] = t52*t[4][i] + t57*t[5][i] + t62*t[6][i];
+            w[8][i] = t52*t[8][i] + t57*t[9][i] + t62*t[10][i];
+        }
+    }
+
+    protected:
+    /**
+     * Exchanges the dense slots of two bodies.
+     */
+    void swapSlots(unsigned a, unsigned b){
+        if (a == b) return;
+        Vector3Array *vectors[7] = {&position, &velocity, &acceleration, &rotation, &forceAccum, &torqueAccum, &lastFrameAcceleration};
+        for (auto array : vectors){
+            std::swap(array->x[a], array->x[b]);
+            std::swap(array->y[a], array->y[b]);
+            std::swap(array->z[a], array->z[b]);
+        }
+        orientation.swap(a, b);
+        inverseInertiaTensor.swap(a, b);
+        inverseInertiaTensorWorld.swap(a, b);
+        transform.swap(a, b);
+        std::swap(inverseMass[a], inverseMass[b]);
+        std::swap(linearDamping[a], linearDamping[b]);
+        std::swap(angularDamping[a], angularDamping[b]);
+        std::swap(motion[a], motion[b]);
+        std::swap(canSleep[a], canSleep[b]);
+        std::swap(indexToHandle[a], indexToHandle[b]);
+        handleToIndex[indexToHandle[a]] = a;
+        handleToIndex[indexToHandle[b]] = b;
+        layoutVersion++;
+    }
+};
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "structre/body.hpp"
+#include "structre/inertia_transform.hpp"
+#include "structre/rigid_body_force.hpp"
+#include "structre/rigid_body_store.hpp"
+#include <cstddef>
+#include <my.h>
+#include <vector>
+
+namespace my{
+/**
+ * Simulates a set of rigid bodies. Each step applies the registered
+ * forces, then advances every awake body and recalculates its
+ * transform and world-space inverse inertia tensor in batched passes
+ * over the store's arrays.
+ */
+class RigidBodyWorld{
+    protected:
+    RigidBodyStore bodies;
+    RigidBodyForceRegistry registry;
+    InertiaTensorTransform inertia;
+    real sleepEpsilon = 0;
+
+    public:
+    void startFrame(){
+        bodies.clearAccumulators();
+    }
+
+    void runPhysics(real duration){
+        registry.updateForces(bodies, duration);
+        const std::size_t awake = bodies.getAwakeCount();
+        bodies.integrateRange(0, awake, duration);
+        bodies.calculateTransforms(0, awake);
+        inertia.transform(bodies, 0, awake);
+        if (sleepEpsilon > 0) updateMotion(duration);
+    }
+
+    /**
+     * Updates the running average of each awake body's squared linear
+     * and angular speed, as RigidBody::updateMotion does, and puts to sleep those
+     * that have come to rest.
+     */
+    void updateMotion(real duration){
+        const real bias = real_pow((real)0.5, duration);
+        const real cap = 10 * sleepEpsilon;
+        const Vector3Array &v = bodies.velocities();
+        const Vector3Array &w = bodies.rotations();
+        const std::vector<unsigned char> &canSleep = bodies.canSleeps();
+        std::vector<real> &motion = bodies.motions();
+
+        // Walk down from the last awake body, so a body swapped in by
+        // putting another to sleep has already been updated.
+        for (std::size_t i = bodies.getAwakeCount(); i-- > 0;){
+            real current = v.x[i]*v.x[i] + v.y[i]*v.y[i] + v.z[i]*v.z[i] +
+                w.x[i]*w.x[i] + w.y[i]*w.y[i] + w.z[i]*w.z[i];
+            real average = bias * motion[i] + (1 - bias) * current;
+            if (average > cap) average = cap;
+            motion[i] = average;
+            if (canSleep[i] && average < sleepEpsilon) bodies.setAwake(bodies.handleAt((unsigned)i), false);
+        }
+    }
+
+    /**
+     * Puts bodies to sleep once a running average of their squared
+     * speed stays below the given threshold. Zero, the default, keeps
+     * every body awake.
+     */
+    void setSleepThreshold(real epsilon){
+        sleepEpsilon = epsilon;
+    }
+
+    /**
+     * Selects the scalar or a vectorised path for transforming the
+     * inertia tensors in the following calls to runPhysics.
+     */
+    void setInertiaTransformMode(InertiaTensorTransform::Mode mode){
+        inertia.setMode(mode);
+    }
+
+    /**
+     * Adds a copy of the given body to the world and returns the
+     * handle it is simulated under.
+     */
+    RigidBodyHandle addBody(const RigidBody &body){
+        return bodies.add(body);
+    }
+
+    auto getBodies(){
+        return &bodies;
+    }
+
+    auto getForceRegistry(){
+        return &registry;
+    }
+};
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "math/precision.hpp"
+#include "math/vector_array.hpp"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace my{
+/**
+ * A uniform grid over a set of points, stored as a spatial hash and
+ * rebuilt from scratch with a counting sort. Points are kept sorted
+ * by bucket along with a copy of their positions and cells, so that
+ * points close in space are also close in memory.
+ *
+ * A cell's bucket is its linear index in a grid just covering the
+ * points, wrapped around the table, rather than a scrambled hash, so
+ * that neighbouring cells also have nearby buckets.
+ */
+class SpatialHash{
+    protected:
+    real invCellSize = 1;
+    unsigned bucketMask = 0;
+    uint32_t strideY = 0;
+    uint32_t strideZ = 0;
+    std::vector<unsigned> pointBucket;
+    std::vector<uint64_t> pointCell;
+    std::vector<unsigned> bucketStart;
+    std::vector<unsigned> sortedIndex;
+    std::vector<uint64_t> sortedCell;
+    Vector3Array sortedPosition;
+
+    public:
+    /**
+     * Sorts the given points into cells of the given size. The table
+     * has at least twice as many buckets as points, to keep unrelated
+     * cells from sharing buckets.
+     */
+    void build(const Vector3Array &positions, real cellSize){
+        const unsigned count = (unsigned)positions.size();
+        invCellSize = (real)1 / cellSize;
+        unsigned buckets = 1;
+        while (buckets < 2 * count) buckets <<= 1;
+        bucketMask = buckets - 1;
+
+        const real *px = positions.x.data();
+        const real *py = positions.y.data();
+        const real *pz = positions.z.data();
+
+        real minX = 0, maxX = 0, minY = 0, maxY = 0;
+        if (count){ minX = maxX = px[0]; minY = maxY = py[0]; }
+        for (unsigned i = 1; i < count; i++){
+            minX = std::fmin(minX, px[i]); maxX = std::fmax(maxX, px[i]);
+            minY = std::fmin(minY, py[i]); maxY = std::fmax(maxY, py[i]);
+        }
+        // Odd strides keep whole planes of cells from landing on the
+        // same buckets when the table is smaller than the grid.
+        strideY = (uint32_t)(cellCoord(maxX) - cellCoord(minX) + 3) | 1;
+        strideZ = (strideY * (uint32_t)(cellCoord(maxY) - cellCoord(minY) + 3)) | 1;
+
+        pointBucket.resize(count);
+        pointCell.resize(count);
+        bucketStart.assign(buckets + 1, 0);
+        for (unsigned i = 0; i < count; i++){
+            const int cx = cellCoord(px[i]), cy = cellCoord(py[i]), cz = cellCoord(pz[i]);
+            unsigned bucket = hashCell(cx, cy, cz);
+            pointBucket[i] = bucket;
+            pointCell[i] = cellKey(cx, cy, cz);
+            bucketStart[bucket + 1]++;
+        }
+        for (unsigned b = 1; b <= buckets; b++){
+            bucketStart[b] += bucketStart[b - 1];
+        }
+
+        sortedIndex.resize(count);
+        for (unsigned i = count; i-- > 0;){
+            sortedIndex[--bucketStart[pointBucket[i] + 1]] = i;
+        }
+        // The fill loop walked each bucket's end back to its start, so
+        // bucketStart[b + 1] now holds the start of bucket b.
+        for (unsigned b = 0; b < buckets; b++){
+            bucketStart[b] = bucketStart[b + 1];
+        }
+        bucketStart[buckets] = count;
+
+        sortedPosition.resize(count);
+        sortedCell.resize(count);
+        for (unsigned k = 0; k < count; k++){
+            unsigned i = sortedIndex[k];
+            sortedCell[k] = pointCell[i];
+            sortedPosition.x[k] = px[i];
+            sortedPosition.y[k] = py[i];
+            sortedPosition.z[k] = pz[i];
+        }
+    }
+
+    unsigned size() const{
+        return (unsigned)sortedIndex.size();
+    }
+
+    /**
+     * Maps a position in sorted order back to the index the point had
+     * in the array passed to build.
+     */
+    unsigned originalIndex(unsigned sorted) const{
+        return sortedIndex[sorted];
+    }
+
+    const Vector3Array &sortedPositions() const{
+        return sortedPosition;
+    }
+
+    /**
+     * Calls visit(i, j, rx, ry, rz, distanceSquared) once for every
+     * pair of points closer than cutoff, where i and j are positions
+     * in sorted order and (rx, ry, rz) points from j to i. The cutoff
+     * must not exceed the cell size. Stops early if visit returns
+     * false.
+     */
+    template<class Visitor>
+    void forEachPair(real cutoff, Visitor visit) const{
+        // The point's own cell and the 13 neighbours that come after it,
+        // so each pair of neighbouring cells is visited once.
+        static const int shell[14][3] = {
+            {0, 0, 0}, {0, 0, 1}, {0, 1, -1}, {0, 1, 0}, {0, 1, 1},
+            {1, -1, -1}, {1, -1, 0}, {1, -1, 1}, {1, 0, -1}, {1, 0, 0},
+            {1, 0, 1}, {1, 1, -1}, {1, 1, 0}, {1, 1, 1}
+        };
+        const unsigned count = size();
+        const real cutoffSquared = cutoff * cutoff;
+        const real *px = sortedPosition.x.data();
+        const real *py = sortedPosition.y.data();
+        const real *pz = sortedPosition.z.data();
+        const uint64_t *cell = sortedCell.data();
+
+        for (unsigned i = 0; i < count; i++){
+            const int cx = cellCoord(px[i]);
+            const int cy = cellCoord(py[i]);
+            const int cz = cellCoord(pz[i]);
+
+            for (unsigned n = 0; n < 14; n++){
+                const int x = cx + shell[n][0], y = cy + shell[n][1], z = cz + shell[n][2];
+                const unsigned bucket = hashCell(x, y, z);
+                const uint64_t key = cellKey(x, y, z);
+
+                // Other cells can share the bucket; only take this one's
+                // points, and in the point's own cell only those after it.
+                unsigned first = bucketStart[bucket];
+                if (n == 0) first = i + 1;
+                for (unsigned j = first; j < bucketStart[bucket + 1]; j++){
+                    if (cell[j] != key) continue;
+                    real rx = px[i] - px[j];
+                    real ry = py[i] - py[j];
+                    real rz = pz[i] - pz[j];
+                    real distanceSquared = rx*rx + ry*ry + rz*rz;
+                    if (distanceSquared >= cutoffSquared) continue;
+                    if (!visit(i, j, rx, ry, rz, distanceSquared)) return;
+                }
+            }
+        }
+    }
+
+    protected:
+    int cellCoord(real value) const{
+        return (int)std::floor(value * invCellSize);
+    }
+
+    static uint64_t cellKey(int x, int y, int z){
+        return ((uint64_t)(uint32_t)x & 0x1fffff) | (((uint64_t)(uint32_t)y & 0x1fffff) << 21) | (((uint64_t)(uint32_t)z & 0x1fffff) << 42);
+    }
+
+    unsigned hashCell(int x, int y, int z) const{
+        return ((uint32_t)x + (uint32_t)y * strideY + (uint32_t)z * strideZ) & bucketMask;
+    }
+};
+}
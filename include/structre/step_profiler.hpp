@@ -0,0 +1,138 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace my{
+/**
+ * What one physics step spent its time on: nanoseconds per phase,
+ * and counts of the work each phase did.
+ */
+struct StepProfile{
+    enum Phase{
+        FORCES,
+        INTEGRATE,
+        CONSTRAINTS,
+        GENERATE_CONTACTS,
+        RESOLVE_CONTACTS,
+        PHASE_COUNT
+    };
+
+    std::uint64_t nanoseconds[PHASE_COUNT] = {};
+    unsigned particles = 0;
+    unsigned awake = 0;
+    unsigned registrations = 0;
+    unsigned contacts = 0;
+    unsigned iterations = 0;
+
+    std::uint64_t getTotalNanoseconds() const{
+        std::uint64_t total = 0;
+        for (auto phase : nanoseconds) total += phase;
+        return total;
+    }
+
+    void add(const StepProfile &other){
+        for (unsigned p = 0; p < PHASE_COUNT; p++) nanoseconds[p] += other.nanoseconds[p];
+        particles += other.particles;
+        awake += other.awake;
+        registrations += other.registrations;
+        contacts += other.contacts;
+        iterations += other.iterations;
+    }
+
+    static const char *getPhaseName(unsigned phase){
+        static const char *names[PHASE_COUNT] = {"forces", "integrate", "constraints", "contacts", "resolve"};
+        return phase < PHASE_COUNT ? names[phase] : "";
+    }
+};
+
+/**
+ * Keeps the profiles of the most recent steps in a ring, oldest
+ * overwritten first.
+ */
+class StepProfiler{
+    protected:
+    std::vector<StepProfile> frames;
+    std::size_t next = 0;
+    std::size_t count = 0;
+
+    public:
+    StepProfiler(std::size_t capacity = 256) : frames(capacity ? capacity : 1){}
+
+    /**
+     * Starts the profile of a new step and returns it to be filled
+     * in.
+     */
+    StepProfile &begin(){
+        StepProfile &frame = frames[next];
+        frame = StepProfile();
+        next = (next + 1) % frames.size();
+        if (count < frames.size()) count++;
+        return frame;
+    }
+
+    /**
+     * Returns how many step profiles are held, at most the capacity.
+     */
+    std::size_t size() const{
+        return count;
+    }
+
+    /**
+     * Returns the profile of a recent step, 0 being the latest.
+     */
+    const StepProfile &get(std::size_t age = 0) const{
+        return frames[(next + frames.size() - 1 - age) % frames.size()];
+    }
+
+    /**
+     * Returns the sum of all held profiles. Divide by size() for the
+     * average step.
+     */
+    StepProfile getTotal() const{
+        StepProfile total;
+        for (std::size_t i = 0; i < count; i++) total.add(get(i));
+        return total;
+    }
+
+    void clear(){
+        next = 0;
+        count = 0;
+    }
+};
+
+/**
+ * Adds the time until it goes out of scope to one phase of a step
+ * profile.
+ */
+class ScopedPhaseTimer{
+    protected:
+    StepProfile &profile;
+    StepProfile::Phase phase;
+    std::chrono::steady_clock::time_point start;
+
+    public:
+    ScopedPhaseTimer(StepProfile &profile, StepProfile::Phase phase) : profile(profile), phase(phase), start(std::chrono::steady_clock::now()){}
+
+    ~ScopedPhaseTimer(){
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        profile.nanoseconds[phase] += (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+};
+}
+
+/**
+ * Instrumentation is only compiled in when MY_PROFILE is defined.
+ * Otherwise these expand to nothing.
+ */
+#ifdef MY_PROFILE
+#define MY_PROFILE_CONCAT_(a, b) a##b
+#define MY_PROFILE_CONCAT(a, b) MY_PROFILE_CONCAT_(a, b)
+#define MY_PROFILE_PHASE(profile, phase) ::my::ScopedPhaseTimer MY_PROFILE_CONCAT(phaseTimer, __LINE__)(profile, ::my::StepProfile::phase)
+#define MY_PROFILE_ONLY(statement) statement
+#else
+#define MY_PROFILE_PHASE(profile, phase)
+#define MY_PROFILE_ONLY(statement)
+#endif
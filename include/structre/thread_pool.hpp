@@ -0,0 +1,143 @@
+#pragma once
+
+#include "structre/trace_recorder.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace my{
+/**
+ * A fixed set of worker threads that split index ranges between
+ * themselves. The calling thread joins in, so a pool of size one
+ * runs everything inline.
+ */
+class ThreadPool{
+    public:
+    typedef std::function<void(unsigned begin, unsigned end)> RangeTask;
+
+    protected:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    bool stopping = false;
+    unsigned generation = 0;
+
+    const RangeTask *task = nullptr;
+    unsigned taskCount = 0;
+    unsigned taskGrain = 1;
+    std::atomic<unsigned> nextBegin{0};
+    unsigned busyWorkers = 0;
+    TraceRecorder *trace = nullptr;
+
+    public:
+    /**
+     * Creates a pool using the given total number of threads,
+     * including the caller. Zero means one per hardware thread.
+     */
+    ThreadPool(unsigned threads = 0){
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 1; i < threads; i++){
+            workers.emplace_back([this]{ workerLoop(); });
+        }
+    }
+
+    ~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+
+    /**
+     * Total number of threads that run tasks, including the caller.
+     */
+    unsigned size() const{
+        return (unsigned)workers.size() + 1;
+    }
+
+    /**
+     * Records the share of each parallelFor every thread runs as a
+     * span on that thread's track. Null switches this off.
+     */
+    void setTraceRecorder(TraceRecorder *recorder){
+        trace = recorder;
+    }
+
+    /**
+     * Calls task on consecutive sub-ranges of [0, count), each at
+     * most grain long, spread over the pool. Returns once every
+     * sub-range has been processed. Must not be called from inside a
+     * task.
+     */
+    void parallelFor(unsigned count, const RangeTask &rangeTask, unsigned grain = 1){
+        if (count == 0) return;
+        if (grain == 0) grain = 1;
+        if (workers.empty() || count <= grain){
+            rangeTask(0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &rangeTask;
+            taskCount = count;
+            taskGrain = grain;
+            nextBegin.store(0);
+            busyWorkers = (unsigned)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        runChunks(rangeTask, count, grain);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]{ return busyWorkers == 0; });
+        task = nullptr;
+    }
+
+    protected:
+    void runChunks(const RangeTask &rangeTask, unsigned count, unsigned grain){
+        TraceRecorder::Span span(trace, "parallelFor", "pool");
+        while (true){
+            unsigned begin = nextBegin.fetch_add(grain);
+            if (begin >= count) break;
+            rangeTask(begin, std::min(count, begin + grain));
+        }
+    }
+
+    void workerLoop(){
+        unsigned seen = 0;
+        while (true){
+            const RangeTask *current;
+            unsigned count, grain;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen]{ return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                current = task;
+                count = taskCount;
+                grain = taskGrain;
+            }
+
+            runChunks(*current, count, grain);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busyWorkers--;
+            }
+            finished.notify_one();
+        }
+    }
+};
+}
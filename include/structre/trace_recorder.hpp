@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#if defined(__GNUC__) || defined(__clang__)
+#include <cxxabi.h>
+#endif
+
+namespace my{
+/**
+ * Records timed spans of the simulation into a ring buffer and writes
+ * them out in the Chrome trace-event format, which chrome://tracing
+ * and Perfetto open directly.
+ *
+ * Any number of threads can record at once without locking: each span
+ * claims a slot with one atomic increment and publishes it when
+ * written. Once the ring is full the oldest spans are overwritten.
+ * Spans are shown on one track per recording thread.
+ *
+ * Writing the trace out should happen while nothing is recording;
+ * spans still being written at that moment are left out.
+ */
+class TraceRecorder{
+    public:
+    /**
+     * Marks a span whose name is a typeid name, to be demangled when
+     * the trace is written.
+     */
+    static const unsigned TYPE_NAME = 1;
+
+    protected:
+    struct Event{
+        const char *name;
+        const char *category;
+        std::uint64_t start;
+        std::uint64_t duration;
+        unsigned thread;
+        unsigned flags;
+        std::atomic<std::uint64_t> published{0};
+    };
+
+    std::unique_ptr<Event[]> events;
+    std::uint64_t mask;
+    std::atomic<std::uint64_t> head{0};
+    std::chrono::steady_clock::time_point origin;
+
+    public:
+    /**
+     * Creates a recorder holding the latest capacity spans, rounded
+     * up to a power of two.
+     */
+    TraceRecorder(std::size_t capacity = 1 << 16) : origin(std::chrono::steady_clock::now()){
+        std::size_t size = 1;
+        while (size < capacity) size <<= 1;
+        events.reset(new Event[size]);
+        mask = size - 1;
+    }
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder &operator=(const TraceRecorder&) = delete;
+
+    /**
+     * Returns the nanoseconds since the recorder was created, the
+     * time base of every span.
+     */
+    std::uint64_t now() const{
+        return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    /**
+     * Returns a small number identifying the calling thread, used as
+     * its track in the trace.
+     */
+    static unsigned threadId(){
+        static std::atomic<unsigned> nextThread{0};
+        thread_local unsigned id = nextThread.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+    /**
+     * Records a span of the calling thread. The name and category
+     * must outlive the recorder, as with string literals.
+     */
+    void record(const char *name, const char *category, std::uint64_t start, std::uint64_t end, unsigned flags = 0){
+        std::uint64_t slot = head.fetch_add(1, std::memory_order_relaxed);
+        Event &event = events[slot & mask];
+        event.published.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        event.name = name;
+        event.category = category;
+        event.start = start;
+        event.duration = end - start;
+        event.thread = threadId();
+        event.flags = flags;
+        event.published.store(slot + 1, std::memory_order_release);
+    }
+
+    /**
+     * Returns how many spans have been recorded, including any that
+     * have since been overwritten.
+     */
+    std::uint64_t getRecordedCount() const{
+        return head.load(std::memory_order_relaxed);
+    }
+
+    std::size_t getCapacity() const{
+        return (std::size_t)mask + 1;
+    }
+
+    void clear(){
+        for (std::uint64_t i = 0; i <= mask; i++) events[i].published.store(0, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Writes the held spans as trace-event JSON. Returns false if the
+     * stream could not be written.
+     */
+    bool write(std::FILE *file) const{
+        std::uint64_t end = head.load(std::memory_order_acquire);
+        std::uint64_t begin = end > mask ? end - mask - 1 : 0;
+        unsigned threads = 0;
+
+        std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        bool first = true;
+        for (std::uint64_t slot = begin; slot < end; slot++){
+            const Event &event = events[slot & mask];
+            if (event.published.load(std::memory_order_acquire) != slot + 1) continue;
+            const char *name = event.name, *category = event.category;
+            std::uint64_t start = event.start, duration = event.duration;
+            unsigned thread = event.thread, flags = event.flags;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (event.published.load(std::memory_order_relaxed) != slot + 1) continue;
+
+            if (thread >= threads) threads = thread + 1;
+            std::fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+            writeEscaped(file, (flags & TYPE_NAME) ? demangle(name).c_str() : name);
+            std::fprintf(file, "\",\"cat\":\"");
+            writeEscaped(file, category);
+            std::fprintf(file, "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                start * 1e-3, duration * 1e-3, thread);
+            first = false;
+        }
+        for (unsigned t = 0; t < threads; t++){
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                first ? "" : ",\n", t, t);
+            first = false;
+        }
+        std::fprintf(file, "\n]}\n");
+        return !std::ferror(file);
+    }
+
+    /**
+     * Writes the held spans to the named file.
+     */
+    bool write(const char *path) const{
+        std::FILE *file = std::fopen(path, "w");
+        if (!file) return false;
+        bool written = write(file);
+        return std::fclose(file) == 0 && written;
+    }
+
+    /**
+     * Times the scope it lives in as one span. Does nothing when
+     * given a null recorder, so tracing can be left switched off at
+     * the cost of a pointer test.
+     */
+    class Span{
+        protected:
+        TraceRecorder *recorder;
+        const char *name;
+        const char *category;
+        unsigned flags;
+        std::uint64_t start;
+
+        public:
+        Span(TraceRecorder *recorder, const char *name, const char *category, unsigned flags = 0) : recorder(recorder), name(name), category(category), flags(flags){
+            start = recorder ? recorder->now() : 0;
+        }
+
+        ~Span(){
+            if (recorder) recorder->record(name, category, start, recorder->now(), flags);
+        }
+
+        Span(const Span&) = delete;
+        Span &operator=(const Span&) = delete;
+    };
+
+    protected:
+    static std::string demangle(const char *name){
+#if defined(__GNUC__) || defined(__clang__)
+        int status = 0;
+        char *readable = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        if (status == 0 && readable){
+            std::string result(readable);
+            std::free(readable);
+            return result;
+        }
+#endif
+        return name;
+    }
+
+    static void writeEscaped(std::FILE *file, const char *text){
+        for (; *text; text++){
+            if (*text == '"' || *text == '\\') std::fputc('\\', file);
+            if ((unsigned char)*text < 0x20) continue;
+            std::fputc(*text, file);
+        }
+    }
+};
+}
@@ -2,121 +2,50 @@
 
 #include <gl/glut.h>
 #include <my.h>
+#include "scenes/ballistic_scene.h"
+#include "structre/fixed_timestep.hpp"
 
 using namespace my;
 
 class BallisticDemo : public Application{
-    enum ShotType{
-        UNUSED = 0,
-        PISTOL,
-        ARTILLERY,
-        FIREBALL,
-        LASER
-    };
+    typedef BallisticScene::AmmoRound AmmoRound;
 
-    struct AmmoRound{
-        Particle particle;
-        ShotType type;
-        double startTime;
+    BallisticScene scene;
+    FixedTimestep timestep;
 
-        void render(){
-            Vector3 position;
-            particle.getPositon(&position);
+    static void render(const AmmoRound &round){
+        Vector3 position;
+        round.particle.getPosition(&position);
 
-            glColor3f(0,0,0);
-            glPushMatrix();
-            glTranslatef(position.x, position.y, position.z);
-            glutSolidSphere(0.3f, 5, 4);
-            glPopMatrix();
-
-            glColor3f(0.75, 0.75, 0.75);
-            glPushMatrix();
-            glTranslatef(position.x, 0, position.z);
-            glScalef(1.0f, 0.1f, 1.0f);
-            glutSolidSphere(0.6f, 5, 4);
-            glPopMatrix();
-        }
-    };
-    
-    const static unsigned ammoRounds = 16;
-
-    AmmoRound ammo[ammoRounds];
-    ShotType currentShotType;
+        glColor3f(0,0,0);
+        glPushMatrix();
+        glTranslatef(position.x, position.y, position.z);
+        glutSolidSphere(0.3f, 5, 4);
+        glPopMatrix();
 
-    void fire(){
-        AmmoRound* shot;
-        for (shot = ammo; shot < ammo+ammoRounds; shot++)
-        {
-            if (shot->type == UNUSED) break;
-        }
-    
-        // If we didn't find a round, then exit - we can't fire.
-        if (shot >= ammo+ammoRounds) return;
-    
-        // Set the properties of the particle
-        switch(currentShotType)
-        {
-        case PISTOL:
-            shot->particle.setMass(2.0f); // 2.0kg
-            shot->particle.setVelocity(0.0f, 0.0f, 35.0f); // 35m/s
-            shot->particle.setAcceleration(0.0f, -1.0f, 0.0f);
-            shot->particle.setDamping(0.99f);
-            break;
-    
-        case ARTILLERY:
-            shot->particle.setMass(200.0f); // 200.0kg
-            shot->particle.setVelocity(0.0f, 30.0f, 40.0f); // 50m/s
-            shot->particle.setAcceleration(0.0f, -20.0f, 0.0f);
-            shot->particle.setDamping(0.99f);
-            break;
-    
-        case FIREBALL:
-            shot->particle.setMass(1.0f); // 1.0kg - mostly blast damage
-            shot->particle.setVelocity(0.0f, 0.0f, 10.0f); // 5m/s
-            shot->particle.setAcceleration(0.0f, 0.6f, 0.0f); // Floats up
-            shot->particle.setDamping(0.9f);
-            break;
-    
-        case LASER:
-            // Note that this is the kind of laser bolt seen in films,
-            // not a realistic laser beam!
-            shot->particle.setMass(0.1f); // 0.1kg - almost no weight
-            shot->particle.setVelocity(0.0f, 0.0f, 100.0f); // 100m/s
-            shot->particle.setAcceleration(0.0f, 0.0f, 0.0f); // No gravity
-            shot->particle.setDamping(0.99f);
-            break;
-        }
-    
-        // Set the data common to all particle types
-        shot->particle.setPosition(0.0f, 1.5f, 0.0f);
-        shot->startTime = TimingData::get().lastFrameTimestamp;
-        shot->type = currentShotType;
-    
-        // Clear the force accumulators
-        shot->particle.clearAccumulator();
+        glColor3f(0.75, 0.75, 0.75);
+        glPushMatrix();
+        glTranslatef(position.x, 0, position.z);
+        glScalef(1.0f, 0.1f, 1.0f);
+        glutSolidSphere(0.6f, 5, 4);
+        glPopMatrix();
     }
 
 public:
-    BallisticDemo():currentShotType(LASER){
-        for (auto shot = ammo; shot < ammo + ammoRounds; shot++){
-            shot->type = UNUSED;
-        }
-    }
-
-    virtual constexpr const char* getTitle(){
+    virtual const char* getTitle(){
         return "Ballistic Demo";
     }
 
     virtual void mouse(int button, int state, int x, int y){
-        if (state == GLUT_DOWN) fire();
+        if (state == GLUT_DOWN) scene.fire();
     }
 
     virtual void key (unsigned char key){
         switch (key){
-        case '1': currentShotType = PISTOL; break;
-        case '2': currentShotType = ARTILLERY; break;
-        case '3': currentShotType = FIREBALL; break;
-        case '4': currentShotType = LASER; break;
+        case '1': scene.currentShotType = BallisticScene::PISTOL; break;
+        case '2': scene.currentShotType = BallisticScene::ARTILLERY; break;
+        case '3': scene.currentShotType = BallisticScene::FIREBALL; break;
+        case '4': scene.currentShotType = BallisticScene::LASER; break;
         }
     }
 
@@ -124,18 +53,7 @@ public:
         float duration = (float)TimingData::get().lastFrameDuration * 0.001f;
         if (duration <= 0.0f) return;
 
-        for (auto shot = ammo; shot < ammo + ammoRounds; shot++){
-            if (shot->type != UNUSED){
-                shot->particle.integrate(duration);
-
-                if (shot->particle.getPositon().y <0.0f ||
-                    shot->startTime+5000 < TimingData::get().lastFrameTimestamp ||
-                    shot->particle.getPositon().z > 200.0f){
-                    
-                    shot->type = UNUSED;
-                }
-            }
-        }
+        timestep.advance(duration, [this](real step){ scene.step(step); });
         Application::update();
     }    
 
@@ -168,11 +86,11 @@ public:
         glEnd();
     
         // Render each particle in turn
-        for (auto shot = ammo; shot < ammo+ammoRounds; shot++)
+        for (const auto &shot : scene.ammo)
         {
-            if (shot->type != UNUSED)
+            if (shot.type != BallisticScene::UNUSED)
             {
-                shot->render();
+                render(shot);
             }
         }
     
@@ -181,12 +99,13 @@ public:
         renderText(10.0f, 34.0f, "Click: Fire\n1-4: Select Ammo");
     
         // Render the name of the current shot type
-        switch(currentShotType)
+        switch(scene.currentShotType)
         {
-        case PISTOL: renderText(10.0f, 10.0f, "Current Ammo: Pistol"); break;
-        case ARTILLERY: renderText(10.0f, 10.0f, "Current Ammo: Artillery"); break;
-        case FIREBALL: renderText(10.0f, 10.0f, "Current Ammo: Fireball"); break;
-        case LASER: renderText(10.0f, 10.0f, "Current Ammo: Laser"); break;
+        case BallisticScene::PISTOL: renderText(10.0f, 10.0f, "Current Ammo: Pistol"); break;
+        case BallisticScene::ARTILLERY: renderText(10.0f, 10.0f, "Current Ammo: Artillery"); break;
+        case BallisticScene::FIREBALL: renderText(10.0f, 10.0f, "Current Ammo: Fireball"); break;
+        case BallisticScene::LASER: renderText(10.0f, 10.0f, "Current Ammo: Laser"); break;
+        default: break;
         }
     }
 };
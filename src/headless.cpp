@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "scenes/ballistic_scene.h"
+#include "scenes/blob_scene.h"
+#include "scenes/fireworks_scene.h"
+
+/**
+ * Creates the scene with the given title, or returns null if there
+ * is no such scene.
+ */
+std::unique_ptr<Scene> createScene(const char* title)
+{
+    if (strcmp(title, "blob") == 0) return std::unique_ptr<Scene>(new BlobScene());
+    if (strcmp(title, "fireworks") == 0) return std::unique_ptr<Scene>(new FireworkScene());
+    if (strcmp(title, "ballistic") == 0) return std::unique_ptr<Scene>(new BallisticScene());
+    return nullptr;
+}
+
+/**
+ * Steps the scene with a fixed duration as fast as possible and
+ * prints how many steps per second it managed. Each step is recorded
+ * on the trace, if there is one.
+ */
+void run(Scene &scene, unsigned steps, my::real duration, my::TraceRecorder* trace)
+{
+    unsigned particles = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < steps; i++)
+    {
+        my::TraceRecorder::Span span(trace, scene.getTitle(), "scene");
+        scene.autoplay(duration);
+        scene.step(duration);
+        particles += scene.getParticleCount();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("%-10s %8u steps %10.3f s %12.0f steps/s %8.1f particles/step\n",
+        scene.getTitle(), steps, elapsed.count(),
+        steps / elapsed.count(), double(particles) / steps);
+
+#ifdef MY_PROFILE
+    // Break the latest steps down by phase
+    const my::StepProfiler* profiler = scene.getProfiler();
+    if (!profiler || profiler->size() == 0) return;
+    my::StepProfile total = profiler->getTotal();
+    double frames = (double)profiler->size();
+    for (unsigned p = 0; p < my::StepProfile::PHASE_COUNT; p++)
+    {
+        printf("  %-10s %10.0f ns/step\n", my::StepProfile::getPhaseName(p), total.nanoseconds[p] / frames);
+    }
+    printf("  %.1f registrations, %.1f contacts, %.1f iterations per step over the last %u steps\n",
+        total.registrations / frames, total.contacts / frames, total.iterations / frames, (unsigned)profiler->size());
+#endif
+}
+
+/**
+ * Runs the physics of the demos without a window:
+ *
+ *   headless [scene] [steps] [duration] [trace]
+ *
+ * With no scene given, every scene is run in turn. The duration of
+ * each step is in seconds and defaults to 1/60. If a trace file is
+ * named, the latest steps are written to it as Chrome trace-event
+ * JSON.
+ */
+int main(int argc, char** argv)
+{
+    const char* titles[] = {"blob", "fireworks", "ballistic"};
+    const char* only = argc > 1 ? argv[1] : nullptr;
+    unsigned steps = argc > 2 ? (unsigned)atoi(argv[2]) : 10000;
+    my::real duration = argc > 3 ? (my::real)atof(argv[3]) : my::real(1.0 / 60.0);
+
+    if (steps == 0 || duration <= 0)
+    {
+        fprintf(stderr, "usage: %s [scene] [steps] [duration] [trace]\n", argv[0]);
+        return 1;
+    }
+
+    const char* tracePath = argc > 4 ? argv[4] : nullptr;
+    std::shared_ptr<my::TraceRecorder> trace;
+    if (tracePath) trace = std::make_shared<my::TraceRecorder>(1 << 20);
+
+    for (auto title : titles)
+    {
+        if (only && strcmp(only, "all") != 0 && strcmp(only, title) != 0) continue;
+        auto scene = createScene(title);
+        scene->setTraceRecorder(trace);
+        run(*scene, steps, duration, trace.get());
+    }
+    if (only && strcmp(only, "all") != 0 && !createScene(only))
+    {
+        fprintf(stderr, "unknown scene: %s\n", only);
+        return 1;
+    }
+    if (trace && !trace->write(tracePath))
+    {
+        fprintf(stderr, "could not write trace: %s\n", tracePath);
+        return 1;
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "module/scene.h"
+#include <my.h>
+
+/**
+ * A gun firing rounds of four kinds along the z axis. Rounds are
+ * retired when they hit the ground, fly out of range or have been in
+ * the air for five seconds.
+ */
+class BallisticScene : public Scene{
+    public:
+    enum ShotType{
+        UNUSED = 0,
+        PISTOL,
+        ARTILLERY,
+        FIREBALL,
+        LASER
+    };
+
+    struct AmmoRound{
+        my::Particle particle;
+        ShotType type;
+        my::real startTime;
+    };
+
+    const static unsigned ammoRounds = 16;
+
+    AmmoRound ammo[ammoRounds];
+    ShotType currentShotType;
+
+    protected:
+    my::real time;
+    my::real nextShot;
+
+    public:
+    BallisticScene() : currentShotType(LASER), time(0), nextShot(0){
+        for (auto shot = ammo; shot < ammo + ammoRounds; shot++){
+            shot->type = UNUSED;
+        }
+    }
+
+    void fire(){
+        AmmoRound* shot;
+        for (shot = ammo; shot < ammo+ammoRounds; shot++)
+        {
+            if (shot->type == UNUSED) break;
+        }
+    
+        // If we didn't find a round, then exit - we can't fire.
+        if (shot >= ammo+ammoRounds) return;
+    
+        // Set the properties of the particle
+        switch(currentShotType)
+        {
+        case PISTOL:
+            shot->particle.setMass(2.0f); // 2.0kg
+            shot->particle.setVelocity(0.0f, 0.0f, 35.0f); // 35m/s
+            shot->particle.setAcceleration(0.0f, -1.0f, 0.0f);
+            shot->particle.setDamping(0.99f);
+            break;
+    
+        case ARTILLERY:
+            shot->particle.setMass(200.0f); // 200.0kg
+            shot->particle.setVelocity(0.0f, 30.0f, 40.0f); // 50m/s
+            shot->particle.setAcceleration(0.0f, -20.0f, 0.0f);
+            shot->particle.setDamping(0.99f);
+            break;
+    
+        case FIREBALL:
+            shot->particle.setMass(1.0f); // 1.0kg - mostly blast damage
+            shot->particle.setVelocity(0.0f, 0.0f, 10.0f); // 5m/s
+            shot->particle.setAcceleration(0.0f, 0.6f, 0.0f); // Floats up
+            shot->particle.setDamping(0.9f);
+            break;
+    
+        case LASER:
+            // Note that this is the kind of laser bolt seen in films,
+            // not a realistic laser beam!
+            shot->particle.setMass(0.1f); // 0.1kg - almost no weight
+            shot->particle.setVelocity(0.0f, 0.0f, 100.0f); // 100m/s
+            shot->particle.setAcceleration(0.0f, 0.0f, 0.0f); // No gravity
+            shot->particle.setDamping(0.99f);
+            break;
+
+        default:
+            return;
+        }
+    
+        // Set the data common to all particle types
+        shot->particle.setPosition(0.0f, 1.5f, 0.0f);
+        shot->startTime = time;
+        shot->type = currentShotType;
+    
+        // Clear the force accumulators
+        shot->particle.clearAccumulator();
+    }
+
+    const char* getTitle() override{
+        return "ballistic";
+    }
+
+    void step(my::real duration) override{
+        time += duration;
+        for (auto shot = ammo; shot < ammo + ammoRounds; shot++){
+            if (shot->type != UNUSED){
+                shot->particle.integrate(duration);
+
+                if (shot->particle.getPosition().y <0.0f ||
+                    shot->startTime+5.0f < time ||
+                    shot->particle.getPosition().z > 200.0f){
+                    
+                    shot->type = UNUSED;
+                }
+            }
+        }
+    }
+
+    /**
+     * Fires a round every tenth of a second, cycling through the
+     * shot types.
+     */
+    void autoplay(my::real duration) override{
+        nextShot -= duration;
+        if (nextShot > 0) return;
+        nextShot += 0.1f;
+        currentShotType = ShotType(currentShotType % LASER + 1);
+        fire();
+    }
+
+    unsigned getParticleCount() override{
+        unsigned count = 0;
+        for (auto shot = ammo; shot < ammo + ammoRounds; shot++){
+            if (shot->type != UNUSED) count++;
+        }
+        return count;
+    }
+};
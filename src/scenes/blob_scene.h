@@ -0,0 +1,246 @@
+#pragma once
+
+#include "module/scene.h"
+#include "structre/particle.hpp"
+#include "structre/particle_force.hpp"
+#include "structre/particle_pairwise.hpp"
+#include "structre/particle_world.hpp"
+#include "structre/pcontacts.hpp"
+#include <cstddef>
+#include <memory>
+#include <my.h>
+#include <vector>
+
+#define BLOB_COUNT 5
+#define PLATFORM_COUNT 10
+#define BLOB_RADIUS 0.4f
+
+class Platform : public my::ParticleContactGenerator{
+    public:
+    my::Vector3 start;
+    my::Vector3 end;
+    std::vector<my::ParticleHandle> particles;
+
+    virtual void addContact(const my::ParticleStore &store, my::ParticleContactArena &contacts){
+        my::real restitution = 1.0f;
+        for (auto particle : particles){
+            auto toParticle = store.getPosition(particle) - start;
+            auto lineDirection = end - start;
+            auto projected = toParticle * lineDirection;
+            auto platformSqLength = lineDirection.squareMagnitude();
+            if (projected <= 0.0){
+                if (toParticle.squareMagnitude() < BLOB_RADIUS * BLOB_RADIUS){
+                    auto contact = contacts.allocate();
+                    if (!contact) return;
+                    contact->contactNormal = toParticle.unit();
+                    contact->contactNormal.z = 0;
+                    contact->restitution = restitution;
+                    contact->particle[0] = particle;
+                    contact->particle[1] = my::NO_PARTICLE;
+                    contact->penetration = BLOB_RADIUS - toParticle.magnitude();
+                }
+            }
+            else if (projected >= platformSqLength) {
+                toParticle = store.getPosition(particle) - end;
+                if (toParticle.squareMagnitude() < BLOB_RADIUS * BLOB_RADIUS){
+                    auto contact = contacts.allocate();
+                    if (!contact) return;
+                    contact->contactNormal = toParticle.unit();
+                    contact->contactNormal.z = 0;
+                    contact->restitution = restitution;
+                    contact->particle[0] = particle;
+                    contact->particle[1] = my::NO_PARTICLE;
+                    contact->penetration = BLOB_RADIUS - toParticle.magnitude();
+                }
+            }
+            else{
+                auto distanceToPlatform = toParticle.squareMagnitude() - projected * projected / lineDirection.squareMagnitude();
+                if (distanceToPlatform < BLOB_RADIUS * BLOB_RADIUS){
+                    auto closestPoint = start + lineDirection * (projected / platformSqLength);
+                    auto contact = contacts.allocate();
+                    if (!contact) return;
+                    contact->contactNormal = (store.getPosition(particle) - closestPoint).unit();
+                    contact->contactNormal.z = 0;
+                    contact->restitution = restitution;
+                    contact->particle[0] = particle;
+                    contact->particle[1] = my::NO_PARTICLE;
+                    contact->penetration = BLOB_RADIUS - my::real_sqrt(distanceToPlatform);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * Lifts the first blob in proportion to how many other blobs it is
+ * interacting with, up to floatHead, so that a clump of blobs can
+ * climb. The pair forces themselves come from the cohesion kernel.
+ */
+class BlobFloat : public my::ParticleForceGenerator{
+    public:
+    my::CohesionKernel kernel;
+    unsigned maxFloat;
+    my::real floatHead;
+    std::vector<my::ParticleHandle> particles;
+
+    virtual void updateForce(my::ParticleStore &store, my::ParticleHandle aimParticle, my::real duration){
+        if (maxFloat == 0) return;
+
+        unsigned joincount = 0;
+        auto aimPosition = store.getPosition(aimParticle);
+        for (auto particle : particles){
+            if (particle == aimParticle) continue;
+            auto distance = (store.getPosition(particle) - aimPosition).magnitude();
+            if (distance > 0 && distance < kernel.maxDistance && kernel(distance) != 0) joincount++;
+        }
+        if (joincount == 0) return;
+
+        my::real force = my::real(float(joincount) / maxFloat) * floatHead;
+        if (force > floatHead) force = floatHead;
+        store.addForce(aimParticle, my::Vector3(0, force, 0));
+    }
+};
+
+/**
+ * A handful of blobs held together by a pairwise cohesion force,
+ * bouncing down a zig-zag of platforms in the xy plane.
+ */
+class BlobScene : public Scene{
+    public:
+    /**
+     * Force applied to the first blob on every step, which is how
+     * the demo lets the user steer it.
+     */
+    my::Vector3 control;
+
+    std::shared_ptr<my::PairwiseForceGenerator<my::CohesionKernel>> cohesion;
+    std::shared_ptr<BlobFloat> blobFloat;
+    std::vector<my::ParticleHandle> blobs;
+    std::vector<std::shared_ptr<Platform>> platforms;
+    my::ParticleWorld world;
+
+    BlobScene() : world(PLATFORM_COUNT + BLOB_COUNT){
+        // Create the blob storage
+        for (auto i = 0; i < BLOB_COUNT; i++){
+            blobs.push_back(world.addParticle(my::Particle()));
+        }
+
+        my::Random r(1);
+    
+        // Create the platforms
+        for (unsigned i = 0; i < PLATFORM_COUNT; i++)
+        {
+            auto platform = std::make_shared<Platform>();
+            platform->start = my::Vector3(
+                my::real(i%2)*10.0f - 5.0f,
+                my::real(i)*4.0f + ((i%2)?0.0f:2.0f),
+                0);
+            platform->start.x += r.randomBinomial(2.0f);
+            platform->start.y += r.randomBinomial(2.0f);
+    
+            platform->end = my::Vector3(
+                my::real(i%2)*10.0f + 5.0f,
+                my::real(i)*4.0f + ((i%2)?2.0f:0.0f),
+                0);
+            platform->end.x += r.randomBinomial(2.0f);
+            platform->end.y += r.randomBinomial(2.0f);
+    
+            // Make sure the platform knows which particles it 
+            // should collide with.
+            platform->particles = blobs;
+            world.getContactGenerators()->push_back(platform);
+            platforms.push_back(platform);
+        }
+    
+        // Create the force generators
+        my::CohesionKernel kernel;
+        kernel.maxAttraction = 20.0f;
+        kernel.maxRepulsion = 10.0f;
+        kernel.minNaturalDistance = BLOB_RADIUS*0.75f;
+        kernel.maxNaturalDistance = BLOB_RADIUS*1.5f;
+        kernel.maxDistance = BLOB_RADIUS * 2.5f;
+        cohesion = std::make_shared<my::PairwiseForceGenerator<my::CohesionKernel>>(kernel.maxDistance, BLOB_RADIUS * 0.5f, kernel);
+
+        blobFloat = std::make_shared<BlobFloat>();
+        blobFloat->kernel = kernel;
+        blobFloat->particles = blobs;
+        blobFloat->maxFloat = 2;
+        blobFloat->floatHead = 8.0f;
+        world.getForceRegistry()->addRegistration(blobs.front(), blobFloat);
+ 
+        // Create the blobs.
+        std::shared_ptr<Platform> p = platforms[PLATFORM_COUNT - 2];
+        my::real fraction = (my::real)1.0 / BLOB_COUNT;
+        my::Vector3 delta = p->end - p->start;
+        auto store = world.getParticles();
+        for (unsigned i = 0; i < BLOB_COUNT; i++)
+        {
+            unsigned me = (i+BLOB_COUNT/2) % BLOB_COUNT;
+            store->setPosition(blobs[i],
+                p->start + delta * (my::real(me)*0.8f*fraction+0.1f) +
+                my::Vector3(0, 1.0f+r.randomReal(), 0));
+
+            auto g = my::GRAVITY;
+            store->setVelocity(blobs[i], 0,0,0);
+            store->setDamping(blobs[i], 0.2f);
+            store->setAcceleration(blobs[i], g * my::real(0.4f));
+            store->setMass(blobs[i], 1.0f);
+            store->clearAccumulator(blobs[i]);
+
+            world.getForceRegistry()->addRegistration(blobs[i], cohesion);
+        }
+    }
+
+    void reset(){
+        my::Random r;
+        std::shared_ptr<Platform> p = platforms[PLATFORM_COUNT - 2];
+        my::real fraction = (my::real) 1.0 / BLOB_COUNT;
+        my::Vector3 delta = p->end - p->start;
+
+        auto store = world.getParticles();
+        auto count = blobs.size();
+        for (std::size_t i = 0; i < count; i++){
+            unsigned me = (i + BLOB_COUNT / 2) % BLOB_COUNT;
+            store->setPosition(blobs[i], p->start + delta * (my::real(me) * 0.8f * fraction + 0.1f ) + my::Vector3(0, 1.0f + r.randomReal(), 0));
+            store->setVelocity(blobs[i], 0, 0, 0);
+            store->clearAccumulator(blobs[i]);
+        }
+    }
+
+    const char* getTitle() override{
+        return "blob";
+    }
+
+    void step(my::real duration) override{
+        // Clear accumulators
+        world.startFrame();
+
+        // Move the controlled blob
+        auto store = world.getParticles();
+        store->addForce(blobs[0], control);
+
+        // Run the simulation
+        world.runPhysics(duration);
+
+        // Bring all the particles back to 2d
+        my::Vector3 position;
+        for (auto blob : blobs)
+        {
+            position = store->getPosition(blob);
+            position.z = 0.0f;
+            store->setPosition(blob, position);
+        }
+    }
+
+    unsigned getParticleCount() override{
+        return (unsigned)world.getParticles()->size();
+    }
+
+    void setTraceRecorder(std::shared_ptr<my::TraceRecorder> recorder) override{
+        world.setTraceRecorder(recorder);
+    }
+
+    const my::StepProfiler* getProfiler() override{
+        return &world.getProfiler();
+    }
+};
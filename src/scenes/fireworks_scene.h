@@ -0,0 +1,161 @@
+#pragma once
+
+#include "module/scene.h"
+#include "structre/particle_emitter.hpp"
+#include <my.h>
+
+typedef my::ParticleEmitterRule FireworkRule;
+
+/**
+ * Fireworks that burst into further fireworks when they burn out or
+ * hit the ground, following a table of FireworkRules.
+ */
+class FireworkScene : public Scene{
+    public:
+    const static unsigned maxFireworks = 1 << 20;
+    const static unsigned rulecount = 9;
+
+    protected:
+    my::Random crandom;
+    my::ParticleEmitterSystem fireworks;
+    FireworkRule rules[rulecount];
+    my::real nextLaunch;
+
+    void initFireWorkRules(){
+        // Go through the firework types and create their rules.
+        rules[0].init(2);
+        rules[0].setParameters(
+            1, // type
+            0.5f, 1.4f, // age range
+            my::Vector3(-5, 25, -5), // min velocity
+            my::Vector3(5, 28, 5), // max velocity
+            0.1 // damping
+            );
+        rules[0].payloads[0].set(3, 5);
+        rules[0].payloads[1].set(5, 5);
+    
+        rules[1].init(1);
+        rules[1].setParameters(
+            2, // type
+            0.5f, 1.0f, // age range
+            my::Vector3(-5, 10, -5), // min velocity
+            my::Vector3(5, 20, 5), // max velocity
+            0.8 // damping
+            );
+        rules[1].payloads[0].set(4, 2);
+    
+        rules[2].init(0);
+        rules[2].setParameters(
+            3, // type
+            0.5f, 1.5f, // age range
+            my::Vector3(-5, -5, -5), // min velocity
+            my::Vector3(5, 5, 5), // max velocity
+            0.1 // damping
+            );
+    
+        rules[3].init(0);
+        rules[3].setParameters(
+            4, // type
+            0.25f, 0.5f, // age range
+            my::Vector3(-20, 5, -5), // min velocity
+            my::Vector3(20, 5, 5), // max velocity
+            0.2 // damping
+            );
+    
+        rules[4].init(1);
+        rules[4].setParameters(
+            5, // type
+            0.5f, 1.0f, // age range
+            my::Vector3(-20, 2, -5), // min velocity
+            my::Vector3(20, 18, 5), // max velocity
+            0.01 // damping
+            );
+        rules[4].payloads[0].set(3, 5);
+    
+        rules[5].init(0);
+        rules[5].setParameters(
+            6, // type
+            3, 5, // age range
+            my::Vector3(-5, 5, -5), // min velocity
+            my::Vector3(5, 10, 5), // max velocity
+            0.95 // damping
+            );
+    
+        rules[6].init(1);
+        rules[6].setParameters(
+            7, // type
+            4, 5, // age range
+            my::Vector3(-5, 50, -5), // min velocity
+            my::Vector3(5, 60, 5), // max velocity
+            0.01 // damping
+            );
+        rules[6].payloads[0].set(8, 10);
+    
+        rules[7].init(0);
+        rules[7].setParameters(
+            8, // type
+            0.25f, 0.5f, // age range
+            my::Vector3(-1, -1, -1), // min velocity
+            my::Vector3(1, 1, 1), // max velocity
+            0.01 // damping
+            );
+    
+        rules[8].init(0);
+        rules[8].setParameters(
+            9, // type
+            3, 5, // age range
+            my::Vector3(-15, 10, -5), // min velocity
+            my::Vector3(15, 15, 5), // max velocity
+            0.95 // damping
+            );
+        // ... and so on for other firework types ...
+    }
+
+    public:
+    FireworkScene(): crandom(1), fireworks(maxFireworks, 1), nextLaunch(0){
+        initFireWorkRules();
+        for (const auto &rule : rules){
+            fireworks.setRule(rule);
+        }
+        fireworks.setFloor(0);
+    }
+
+    /**
+     * Launches number fireworks of the given type from one of three
+     * spots on the ground.
+     */
+    void launch(unsigned type, unsigned number = 1){
+        for (unsigned i = 0; i < number; i++){
+            my::Vector3 start;
+            int x = (int)crandom.randomInt(3) - 1;
+            start.x = 5.0f * my::real(x);
+            fireworks.emit(type, start, my::Vector3(), 1);
+        }
+    }
+
+    const my::ParticleEmitterSystem &getFireworks() const{
+        return fireworks;
+    }
+
+    const char* getTitle() override{
+        return "fireworks";
+    }
+
+    void step(my::real duration) override{
+        fireworks.update(duration);
+    }
+
+    /**
+     * Launches a firework of a random type every tenth of a second.
+     */
+    void autoplay(my::real duration) override{
+        nextLaunch -= duration;
+        if (nextLaunch > 0) return;
+        nextLaunch += 0.1f;
+        launch(crandom.randomInt(rulecount) + 1);
+    }
+
+    unsigned getParticleCount() override{
+        return (unsigned)fireworks.size();
+    }
+};
@@ -0,0 +1,142 @@
+#include "structre/particle_constraints.hpp"
+#include "structre/particle_world.hpp"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <my.h>
+#include <vector>
+
+/**
+ * Checks that distance constraints keep a hanging chain of rods at its
+ * length, that cables only pull, that compliant rods stretch under
+ * load while rigid ones do not, and that a constraint to a sleeping
+ * particle wakes it.
+ */
+static std::vector<my::ParticleHandle> addChain(my::ParticleWorld &world, unsigned count, my::real spacing)
+{
+    std::vector<my::ParticleHandle> handles;
+    for (unsigned i = 0; i < count; i++) {
+        my::Particle particle;
+        particle.setPosition(my::real(i) * spacing, 10, 0);
+        particle.setAcceleration(i == 0 ? my::Vector3() : my::GRAVITY);
+        particle.setDamping(0.99f);
+        particle.setMass(1);
+        if (i == 0) particle.setInverseMass(0);
+        handles.push_back(world.addParticle(particle));
+    }
+    return handles;
+}
+
+static my::real hang(my::real compliance, my::real &maxError)
+{
+    my::ParticleWorld world(16);
+    auto handles = addChain(world, 16, 0.5f);
+    auto solver = std::make_shared<my::DistanceConstraintSolver>(16);
+    for (unsigned i = 1; i < handles.size(); i++) solver->addRod(handles[i - 1], handles[i], 0.5f, compliance);
+    world.setConstraintSolver(solver);
+
+    for (unsigned step = 0; step < 240; step++) {
+        world.startFrame();
+        world.runPhysics(1.0f / 60);
+    }
+    maxError = 0;
+    for (unsigned c = 0; c < solver->size(); c++) {
+        maxError = std::fmax(maxError, std::fabs(solver->getError(*world.getParticles(), c)));
+    }
+    return world.getParticles()->getPosition(handles.back()).y;
+}
+
+static int testRods()
+{
+    int failures = 0;
+
+    my::real rigidError, softError;
+    my::real rigidEnd = hang(0, rigidError);
+    hang(1e-3f, softError);
+
+    // The chain swings down to hang from its anchor, 7.5 long.
+    if (rigidEnd > 10 - 6.0f) {
+        std::printf("rigid chain end is at height %f, expected it to hang down\n", rigidEnd);
+        failures++;
+    }
+    if (rigidError > 0.01f) {
+        std::printf("rigid rods are off their length by %f\n", rigidError);
+        failures++;
+    }
+    if (!(softError > 2 * rigidError)) {
+        std::printf("compliant rods (error %f) do not stretch more than rigid ones (error %f)\n", softError, rigidError);
+        failures++;
+    }
+    return failures;
+}
+
+static int testCable()
+{
+    int failures = 0;
+
+    my::ParticleWorld world(16);
+    my::Particle particle;
+    particle.setDamping(1);
+    particle.setMass(1);
+    particle.setPosition(0, 0, 0);
+    auto a = world.addParticle(particle);
+    particle.setPosition(1, 0, 0);
+    particle.setVelocity(1, 0, 0);
+    auto b = world.addParticle(particle);
+
+    auto solver = std::make_shared<my::DistanceConstraintSolver>(4);
+    solver->addCable(a, b, 2);
+    world.setConstraintSolver(solver);
+    auto store = world.getParticles();
+
+    // Slack: nothing pulls the particles together.
+    world.startFrame();
+    world.runPhysics(0.5f);
+    if (store->getVelocity(a).x != 0 || store->getVelocity(b).x != 1) {
+        std::printf("slack cable changed velocities\n");
+        failures++;
+    }
+
+    // Taut: the cable stops them separating, sharing the momentum.
+    for (unsigned step = 0; step < 60; step++) {
+        world.startFrame();
+        world.runPhysics(1.0f / 60);
+    }
+    my::real separation = (store->getPosition(b) - store->getPosition(a)).magnitude();
+    if (separation > 2.001f) {
+        std::printf("taut cable let the particles separate to %f\n", separation);
+        failures++;
+    }
+    my::real momentum = store->getVelocity(a).x + store->getVelocity(b).x;
+    if (std::fabs(momentum - 1) > 1e-4f) {
+        std::printf("cable changed the momentum to %f\n", momentum);
+        failures++;
+    }
+    return failures;
+}
+
+static int testWakes()
+{
+    int failures = 0;
+
+    my::ParticleWorld world(16);
+    auto handles = addChain(world, 3, 0.5f);
+    auto solver = std::make_shared<my::DistanceConstraintSolver>(4);
+    solver->addRod(handles[1], handles[2], 0.5f);
+    world.setConstraintSolver(solver);
+    auto store = world.getParticles();
+    store->setAwake(handles[2], false);
+
+    world.startFrame();
+    world.runPhysics(1.0f / 60);
+    if (!store->isAwake(handles[2])) {
+        std::printf("rod to an awake particle did not wake its other end\n");
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    return testRods() + testCable() + testWakes();
+}
@@ -0,0 +1,84 @@
+#include "structre/particle_emitter.hpp"
+#include <cstdio>
+#include <my.h>
+
+/**
+ * Checks that the emitter never exceeds its capacity, that dying
+ * particles are replaced by their payloads, and that ages and types
+ * stay with their particles when others are swap-removed.
+ */
+static my::ParticleEmitterSystem makeSystem(std::size_t capacity)
+{
+    my::ParticleEmitterSystem system(capacity, 3);
+
+    my::ParticleEmitterRule shortLived;
+    shortLived.init(1);
+    shortLived.setParameters(1, 0.1f, 0.5f, my::Vector3(-1, 5, -1), my::Vector3(1, 6, 1), 0.9f);
+    shortLived.payloads[0].set(2, 3);
+    system.setRule(shortLived);
+
+    my::ParticleEmitterRule longLived;
+    longLived.setParameters(2, 10, 11, my::Vector3(-1, -1, -1), my::Vector3(1, 1, 1), 0.9f);
+    system.setRule(longLived);
+    return system;
+}
+
+int main()
+{
+    int failures = 0;
+
+    auto full = makeSystem(8);
+    if (full.emit(2, my::Vector3(), my::Vector3(), 10) != 8 || full.size() != 8 ||
+        full.emit(2, my::Vector3(), my::Vector3(), 1) != 0) {
+        std::printf("emit went past the capacity\n");
+        failures++;
+    }
+
+    // Types without a rule emit nothing.
+    auto unknown = makeSystem(8);
+    if (unknown.emit(0, my::Vector3(), my::Vector3(), 1) != 0 ||
+        unknown.emit(3, my::Vector3(), my::Vector3(), 1) != 0 ||
+        unknown.emit(99, my::Vector3(), my::Vector3(), 1) != 0 || unknown.size() != 0) {
+        std::printf("emitted particles of a type without a rule\n");
+        failures++;
+    }
+
+    auto system = makeSystem(1000);
+    system.emit(1, my::Vector3(0, 10, 0), my::Vector3(), 100);
+    system.emit(2, my::Vector3(0, 10, 0), my::Vector3(), 50);
+    my::real elapsed = 0;
+    for (unsigned step = 0; step < 60; step++) {
+        system.update(0.01f);
+        elapsed += 0.01f;
+        for (std::size_t i = 0; i < system.size(); i++) {
+            const my::ParticleEmitterRule &rule = system.getRule(system.getType(i));
+            if (system.getAge(i) < 0 || system.getAge(i) > rule.maxAge) {
+                std::printf("particle %zu has an age outside its rule after step %u\n", i, step);
+                failures++;
+                step = 60;
+                break;
+            }
+        }
+    }
+    if (system.size() != 50 + 100 * 3) {
+        std::printf("expected 350 particles after all type 1 died, have %zu\n", system.size());
+        failures++;
+    }
+    for (std::size_t i = 0; i < system.size(); i++) {
+        if (system.getType(i) != 2) {
+            std::printf("a type 1 particle outlived its age\n");
+            failures++;
+            break;
+        }
+    }
+
+    // Dying particles free their space before their payloads need it.
+    auto tight = makeSystem(10);
+    tight.emit(1, my::Vector3(0, 10, 0), my::Vector3(), 5);
+    for (unsigned step = 0; step < 60; step++) tight.update(0.01f);
+    if (tight.size() != 10) {
+        std::printf("expected a full pool of payloads, have %zu\n", tight.size());
+        failures++;
+    }
+    return failures;
+}
@@ -0,0 +1,59 @@
+#include "structre/particle_integrator.hpp"
+#include "structre/particle_store.hpp"
+#include <cstdio>
+#include <my.h>
+
+/**
+ * Checks that each vectorised integration path matches the scalar
+ * path within ParticleIntegrator::TOLERANCE.
+ */
+static bool close(my::real a, my::real b)
+{
+    my::real scale = my::real_abs(a) > 1 ? my::real_abs(a) : 1;
+    return my::real_abs(a - b) <= my::ParticleIntegrator::TOLERANCE * scale;
+}
+
+int main()
+{
+    my::Random r(7);
+    my::ParticleStore reference;
+    for (unsigned i = 0; i < 1003; i++) {
+        my::Particle particle;
+        particle.setPosition(r.randomVector(my::Vector3(50, 50, 50)));
+        particle.setVelocity(r.randomVector(my::Vector3(5, 5, 5)));
+        particle.setAcceleration(my::GRAVITY);
+        particle.setForceAccum(r.randomVector(my::Vector3(3, 3, 3)));
+        particle.setDamping(0.5f + 0.5f * r.randomReal());
+        particle.setMass(0.5f + r.randomReal());
+        reference.add(particle);
+    }
+
+    const my::ParticleIntegrator::Mode modes[] = {
+        my::ParticleIntegrator::SSE,
+        my::ParticleIntegrator::AVX2
+    };
+    int failures = 0;
+    for (auto mode : modes) {
+        if (!my::ParticleIntegrator::supports(mode)) continue;
+
+        my::ParticleStore scalar = reference;
+        my::ParticleStore vector = reference;
+        my::ParticleIntegrator integrator(mode);
+        for (unsigned step = 0; step < 100; step++) {
+            scalar.integrate(0.016f);
+            integrator.integrate(vector, 0.016f);
+        }
+
+        for (unsigned i = 0; i < scalar.size(); i++) {
+            my::Vector3 p0 = scalar.positions().get(i), p1 = vector.positions().get(i);
+            my::Vector3 v0 = scalar.velocities().get(i), v1 = vector.velocities().get(i);
+            if (!close(p0.x, p1.x) || !close(p0.y, p1.y) || !close(p0.z, p1.z) ||
+                !close(v0.x, v1.x) || !close(v0.y, v1.y) || !close(v0.z, v1.z)) {
+                std::printf("mode %d differs at particle %u\n", (int)mode, i);
+                failures++;
+                break;
+            }
+        }
+    }
+    return failures;
+}
@@ -0,0 +1,158 @@
+#include "structre/particle_links.hpp"
+#include "structre/particle_store.hpp"
+#include "structre/pcontacts.hpp"
+#include <cmath>
+#include <cstdio>
+#include <my.h>
+#include <vector>
+
+/**
+ * Checks that ParticleLinkRegistry generates the same contacts as the
+ * ParticleCable and ParticleRod it replaces, that it follows particles
+ * moved by a removal, that links between sleeping particles generate
+ * nothing, and that it stops when the arena is full.
+ */
+static my::ParticleHandle addAt(my::ParticleStore &store, my::real x, my::real y, my::real z)
+{
+    my::Particle particle;
+    particle.setPosition(x, y, z);
+    particle.setMass(1);
+    particle.setDamping(0.99f);
+    return store.add(particle);
+}
+
+static bool sameContact(const my::ParticleContact &a, const my::ParticleContact &b)
+{
+    const my::real tolerance = 1e-5f;
+    return a.particle[0] == b.particle[0] && a.particle[1] == b.particle[1] &&
+           (a.contactNormal - b.contactNormal).magnitude() < tolerance &&
+           std::fabs(a.penetration - b.penetration) < tolerance &&
+           a.restitution == b.restitution;
+}
+
+static int testMatchesLinks()
+{
+    int failures = 0;
+
+    my::ParticleStore store;
+    auto a = addAt(store, 0, 0, 0);
+    auto b = addAt(store, 1, 2, 2);      // 3 from a
+    auto c = addAt(store, 0, 0, 1);      // 1 from a
+    auto d = addAt(store, 0, 4, 0);      // 4 from a
+
+    std::vector<my::ParticleCable> cables(2);
+    cables[0].particle[0] = a; cables[0].particle[1] = b; cables[0].maxLength = 2; cables[0].restitution = 0.5f;
+    cables[1].particle[0] = a; cables[1].particle[1] = c; cables[1].maxLength = 2; cables[1].restitution = 0.5f;
+    std::vector<my::ParticleRod> rods(2);
+    rods[0].particle[0] = a; rods[0].particle[1] = d; rods[0].length = 3;
+    rods[1].particle[0] = c; rods[1].particle[1] = d; rods[1].length = 5;
+
+    std::vector<my::ParticleContact> expected;
+    for (const auto &cable : cables) {
+        my::ParticleContact contact;
+        if (cable.fillContact(store, &contact, 1)) expected.push_back(contact);
+    }
+    for (const auto &rod : rods) {
+        my::ParticleContact contact;
+        if (rod.fillContact(store, &contact, 1)) expected.push_back(contact);
+    }
+
+    my::ParticleLinkRegistry registry;
+    for (const auto &cable : cables) registry.add(cable);
+    for (const auto &rod : rods) registry.add(rod);
+    my::ParticleContactArena contacts(16);
+    registry.addContact(store, contacts);
+
+    // The slack cable generates nothing; the stretched cable and rod
+    // and the compressed rod generate one contact each.
+    if (contacts.size() != 3 || expected.size() != 3) {
+        std::printf("registry generated %u contacts and the links %u, expected 3\n", contacts.size(), (unsigned)expected.size());
+        return failures + 1;
+    }
+    for (unsigned i = 0; i < 3; i++) {
+        if (!sameContact(contacts[i], expected[i])) {
+            std::printf("contact %u differs from the link's\n", i);
+            failures++;
+        }
+    }
+    // A compressed rod pushes its particles apart, against the
+    // direction from the first to the second.
+    if (!(contacts[2].penetration > 0) || contacts[2].contactNormal.y > 0) {
+        std::printf("compressed rod contact has penetration %f and normal y %f\n", contacts[2].penetration, contacts[2].contactNormal.y);
+        failures++;
+    }
+    return failures;
+}
+
+static int testFollowsRemoval()
+{
+    int failures = 0;
+
+    my::ParticleStore store;
+    auto spare = addAt(store, 9, 9, 9);
+    auto a = addAt(store, 0, 0, 0);
+    auto b = addAt(store, 3, 0, 0);
+
+    my::ParticleLinkRegistry registry;
+    registry.addCable(a, b, 2, 0);
+    my::ParticleContactArena contacts(4);
+    registry.addContact(store, contacts);
+
+    // Removing the first particle moves the others to new slots.
+    store.remove(spare);
+    store.setPosition(b, 0, 5, 0);
+    contacts.reset();
+    registry.addContact(store, contacts);
+    if (contacts.size() != 1 || std::fabs(contacts[0].penetration - 3) > 1e-5f || contacts[0].contactNormal.y < 0.99f) {
+        std::printf("registry did not follow the particles after a removal\n");
+        failures++;
+    }
+    return failures;
+}
+
+static int testSleeping()
+{
+    int failures = 0;
+
+    my::ParticleStore store;
+    auto a = addAt(store, 0, 0, 0);
+    auto b = addAt(store, 3, 0, 0);
+    auto c = addAt(store, 6, 0, 0);
+
+    my::ParticleLinkRegistry registry;
+    registry.addRod(a, b, 2);
+    registry.addRod(b, c, 2);
+    store.setAwake(b, false);
+    store.setAwake(c, false);
+
+    my::ParticleContactArena contacts(4);
+    registry.addContact(store, contacts);
+    if (contacts.size() != 1 || contacts[0].particle[0] != a) {
+        std::printf("expected only the rod to the awake particle to generate a contact, got %u\n", contacts.size());
+        failures++;
+    }
+    return failures;
+}
+
+static int testFullArena()
+{
+    int failures = 0;
+
+    my::ParticleStore store;
+    my::ParticleLinkRegistry registry;
+    auto a = addAt(store, 0, 0, 0);
+    for (unsigned i = 0; i < 8; i++) registry.addCable(a, addAt(store, 0, my::real(i + 2), 0), 1, 0);
+
+    my::ParticleContactArena contacts(5);
+    registry.addContact(store, contacts);
+    if (contacts.size() != 5 || !contacts.full()) {
+        std::printf("registry filled %u of 5 contacts\n", contacts.size());
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    return testMatchesLinks() + testFollowsRemoval() + testSleeping() + testFullArena();
+}
@@ -0,0 +1,65 @@
+#include "structre/particle_world.hpp"
+#include <cstdio>
+#include <memory>
+#include <my.h>
+
+/**
+ * Checks that each step of a world gets a profile whose counters
+ * match the work done, leaving out the registrations of sleeping
+ * particles, and that the profiler keeps only the latest steps.
+ */
+int main()
+{
+    int failures = 0;
+
+    my::ParticleWorld world(64);
+    std::vector<my::ParticleHandle> handles;
+    auto gravity = std::make_shared<my::ParticleGravity>(my::GRAVITY);
+    for (unsigned i = 0; i < 10; i++) {
+        my::Particle particle;
+        particle.setMass(1);
+        particle.setPosition(my::real(i), i < 4 ? -0.5f : 5.0f, 0);
+        handles.push_back(world.addParticle(particle));
+        world.getForceRegistry()->addRegistration(handles.back(), gravity);
+    }
+    auto ground = std::make_shared<my::GroundContacts>();
+    ground->init(handles);
+    world.getContactGenerators()->push_back(ground);
+
+    world.startFrame();
+    world.runPhysics(0.01f);
+
+    const my::StepProfiler &profiler = world.getProfiler();
+    const my::StepProfile &frame = profiler.get();
+    if (profiler.size() != 1 || frame.particles != 10 || frame.registrations != 10 || frame.contacts != 4) {
+        std::printf("profile counted %u particles, %u registrations, %u contacts\n",
+            frame.particles, frame.registrations, frame.contacts);
+        failures++;
+    }
+    if (frame.iterations == 0 || frame.iterations > 8) {
+        std::printf("profile counted %u resolver iterations\n", frame.iterations);
+        failures++;
+    }
+    if (frame.getTotalNanoseconds() == 0) {
+        std::printf("no time was recorded for the step\n");
+        failures++;
+    }
+
+    // A sleeping particle's registration is not applied, nor counted.
+    world.getParticles()->setAwake(handles[9], false);
+    world.startFrame();
+    world.runPhysics(0.01f);
+    if (profiler.size() != 2 || profiler.get().registrations != 9) {
+        std::printf("profile counted %u registrations with one particle asleep\n", profiler.get().registrations);
+        failures++;
+    }
+
+    my::StepProfiler ring(4);
+    for (unsigned i = 0; i < 6; i++) ring.begin().contacts = i;
+    if (ring.size() != 4 || ring.get().contacts != 5 || ring.get(3).contacts != 2 || ring.getTotal().contacts != 14) {
+        std::printf("ring kept the wrong profiles\n");
+        failures++;
+    }
+
+    return failures;
+}
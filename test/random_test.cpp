@@ -0,0 +1,135 @@
+#include "math/random.hpp"
+#include "math/random_stream.hpp"
+#include <cmath>
+#include <cstdio>
+#include <my.h>
+#include <vector>
+
+/**
+ * Checks that seeded streams are reproducible, that the bulk fills
+ * draw the same numbers as single calls, and that values stay within
+ * their documented ranges.
+ */
+static int testRandom()
+{
+    int failures = 0;
+
+    my::Random a(42), b(42), c(43);
+    bool differs = false;
+    for (unsigned i = 0; i < 1000; i++) {
+        unsigned bits = a.randomBits();
+        if (bits != b.randomBits()) {
+            std::printf("streams with the same seed differ at %u\n", i);
+            failures++;
+            break;
+        }
+        differs |= (bits != c.randomBits());
+    }
+    if (!differs) {
+        std::printf("streams with different seeds agree\n");
+        failures++;
+    }
+
+    my::Random single(9), bulk(9);
+    std::vector<my::real> reals(1001);
+    bulk.fillReal(reals.data(), reals.size(), -2.0f, 3.0f);
+    for (unsigned i = 0; i < reals.size(); i++) {
+        if (reals[i] != single.randomReal(-2.0f, 3.0f) || reals[i] < -2.0f || reals[i] >= 3.0f) {
+            std::printf("fillReal differs at %u\n", i);
+            failures++;
+            break;
+        }
+    }
+
+    my::Vector3 min(-5, 10, -5), max(5, 20, 5);
+    std::vector<my::Vector3> vectors(1001);
+    bulk.fillVector(vectors.data(), vectors.size(), min, max);
+    for (unsigned i = 0; i < vectors.size(); i++) {
+        my::Vector3 expected = single.randomVector(min, max);
+        const my::Vector3 &v = vectors[i];
+        if (v.x != expected.x || v.y != expected.y || v.z != expected.z ||
+            v.x < min.x || v.y < min.y || v.z < min.z || v.x >= max.x || v.y >= max.y || v.z >= max.z) {
+            std::printf("fillVector differs at %u\n", i);
+            failures++;
+            break;
+        }
+    }
+
+    for (unsigned i = 0; i < 10000; i++) {
+        my::real r = single.randomReal();
+        if (r < 0 || r >= 1 || single.randomInt(7) >= 7) {
+            std::printf("value out of range at %u\n", i);
+            failures++;
+            break;
+        }
+    }
+    return failures;
+}
+
+/**
+ * Checks that RandomStream gives the same samples however a range is
+ * split between fills, and that samples land where they should.
+ */
+static int testRandomStream()
+{
+    int failures = 0;
+    const unsigned count = 1003;
+    my::Vector3 min(-1, -2, -3), max(1, 2, 3);
+
+    my::Vector3Array whole, pieces;
+    whole.resize(count);
+    pieces.resize(count);
+    my::RandomStream a(5), b(5);
+    a.fillUniform(whole, 0, count, min, max);
+    for (unsigned begin = 0; begin < count; begin += 7) {
+        unsigned n = count - begin < 7 ? count - begin : 7;
+        b.fillUniform(pieces, begin, n, min, max);
+    }
+    for (unsigned i = 0; i < count; i++) {
+        my::Vector3 v = whole.get(i), w = pieces.get(i);
+        if (v.x != w.x || v.y != w.y || v.z != w.z ||
+            v.x < min.x || v.y < min.y || v.z < min.z || v.x >= max.x || v.y >= max.y || v.z >= max.z) {
+            std::printf("fillUniform differs at %u\n", i);
+            failures++;
+            break;
+        }
+    }
+
+    // A thread that seeks to its own range sees the same samples.
+    my::RandomStream c(5);
+    c.seek(500);
+    c.fillBinomial(pieces, 500, count - 500, my::Vector3(1, 2, 3));
+    a.seek(0);
+    a.fillBinomial(whole, 0, count, my::Vector3(1, 2, 3));
+    for (unsigned i = 500; i < count; i++) {
+        my::Vector3 v = whole.get(i), w = pieces.get(i);
+        if (v.x != w.x || v.y != w.y || v.z != w.z || my::real_abs(v.x) > 1 || my::real_abs(v.y) > 2 || my::real_abs(v.z) > 3) {
+            std::printf("fillBinomial differs at %u\n", i);
+            failures++;
+            break;
+        }
+    }
+
+    my::Vector3 mean;
+    a.fillUnitSphere(whole, 0, count, 2.0f);
+    for (unsigned i = 0; i < count; i++) {
+        my::Vector3 v = whole.get(i);
+        mean += v;
+        if (my::real_abs(v.magnitude() - 2.0f) > 1e-4f) {
+            std::printf("fillUnitSphere sample %u is off the sphere\n", i);
+            failures++;
+            break;
+        }
+    }
+    mean *= 1.0f / count;
+    if (mean.magnitude() > 0.2f) {
+        std::printf("fillUnitSphere samples are lopsided\n");
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    return testRandom() + testRandomStream();
+}
@@ -0,0 +1,226 @@
+#include "structre/pcontacts.hpp"
+#include "structre/particle_store.hpp"
+#include <cstdio>
+#include <my.h>
+#include <vector>
+
+/**
+ * Checks that the priority-queue resolver resolves contacts in the
+ * same order as the linear scan, that the graph-coloured and island
+ * resolvers give the same result with and without a thread pool, and
+ * that each island is resolved as if it were alone, by comparing the
+ * final particle state bit for bit. The graph-coloured resolver is
+ * also checked to actually resolve its contacts, including those past
+ * MAX_COLORS that go into the serial overflow batch.
+ */
+static void buildScene(my::ParticleStore &store, my::ParticleContactArena &contacts)
+{
+    my::Random r(3);
+    for (unsigned i = 0; i < 200; i++) {
+        my::Particle particle;
+        particle.setPosition(my::real(i % 20), my::real(i / 20), 0);
+        particle.setVelocity(my::real(int(r.randomInt(11)) - 5), my::real(int(r.randomInt(11)) - 5), 0);
+        particle.setAcceleration(my::GRAVITY);
+        if (i % 17) particle.setMass(1.0f + r.randomInt(4));
+        store.add(particle);
+    }
+    for (unsigned i = 0; i < 600; i++) {
+        my::ParticleContact *contact = contacts.allocate();
+        contact->particle[0] = r.randomInt(200);
+        contact->particle[1] = (i % 3) ? (r.randomInt(200)) : my::NO_PARTICLE;
+        if (contact->particle[0] == contact->particle[1]) contact->particle[1] = my::NO_PARTICLE;
+        my::Vector3 normal(my::real(int(r.randomInt(7)) - 3), my::real(int(r.randomInt(7)) + 1), 0);
+        normal.normalize();
+        contact->contactNormal = normal;
+        contact->penetration = 0.01f * r.randomInt(10);
+        contact->restitution = 0.25f * r.randomInt(4);
+    }
+}
+
+static bool sameState(const my::ParticleStore &a, const my::ParticleStore &b)
+{
+    for (unsigned i = 0; i < a.size(); i++) {
+        my::Vector3 p0 = a.positions().get(i), p1 = b.positions().get(i);
+        my::Vector3 v0 = a.velocities().get(i), v1 = b.velocities().get(i);
+        if (p0.x != p1.x || p0.y != p1.y || p0.z != p1.z ||
+            v0.x != v1.x || v0.y != v1.y || v0.z != v1.z) {
+            std::printf("state differs at particle %u\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool resolveAndCompare(my::ParticleContactResolver &a, my::ParticleContactResolver &b)
+{
+    my::ParticleStore storeA, storeB;
+    my::ParticleContactArena contactsA(600), contactsB(600);
+    buildScene(storeA, contactsA);
+    buildScene(storeB, contactsB);
+    a.resolveContacts(contactsA.data(), contactsA.size(), storeA, 0.01f);
+    b.resolveContacts(contactsB.data(), contactsB.size(), storeB, 0.01f);
+    return sameState(storeA, storeB);
+}
+
+static bool resolveIslandsAndCompare(my::ParticleContactResolver &a, my::ParticleContactResolver &b)
+{
+    my::ParticleStore storeA, storeB;
+    my::ParticleContactArena contactsA(600), contactsB(600);
+    buildScene(storeA, contactsA);
+    buildScene(storeB, contactsB);
+    a.resolveIslands(contactsA.data(), contactsA.size(), storeA, 0.01f);
+    b.resolveIslands(contactsB.data(), contactsB.size(), storeB, 0.01f);
+    return a.getIterationsUsed() == b.getIterationsUsed() && sameState(storeA, storeB);
+}
+
+/**
+ * Builds piles of particles stacked in columns, with each column
+ * resting on the ground and leaning on one shared immovable wall.
+ * Only the particles of the given column move unless column is -1.
+ */
+static void buildPiles(my::ParticleStore &store, my::ParticleContactArena &contacts, int column)
+{
+    my::ParticleHandle wall = store.add();
+    std::vector<my::ParticleHandle> handles;
+    for (unsigned i = 0; i < 12; i++) {
+        my::Particle particle;
+        particle.setPosition(my::real(i / 4), my::real(i % 4), 0);
+        particle.setVelocity(0, -my::real(i % 4 + 1), 0);
+        particle.setMass(1.0f + i % 3);
+        handles.push_back(store.add(particle));
+    }
+    for (unsigned i = 0; i < 12; i++) {
+        if (column >= 0 && int(i / 4) != column) continue;
+        my::ParticleContact *contact = contacts.allocate();
+        contact->particle[0] = handles[i];
+        contact->particle[1] = (i % 4) ? handles[i - 1] : my::NO_PARTICLE;
+        contact->contactNormal = my::UP;
+        contact->penetration = 0.05f;
+        contact->restitution = 0.5f;
+
+        contact = contacts.allocate();
+        contact->particle[0] = handles[i];
+        contact->particle[1] = wall;
+        contact->contactNormal = my::Vector3(1, 0, 0);
+        contact->penetration = 0.01f;
+        contact->restitution = 0.1f;
+    }
+}
+
+static bool islandsResolveAlone()
+{
+    my::ParticleStore all;
+    my::ParticleContactArena allContacts(64);
+    buildPiles(all, allContacts, -1);
+    my::ParticleContactResolver resolver(0, my::ParticleContactResolver::PRIORITY_QUEUE);
+    resolver.resolveIslands(allContacts.data(), allContacts.size(), all, 0.01f);
+    if (resolver.getIslands().size() != 3 || resolver.getIterationsUsed() != 2 * allContacts.size()) {
+        std::printf("found %u islands using %u iterations\n", resolver.getIslands().size(), resolver.getIterationsUsed());
+        return false;
+    }
+
+    for (int column = 0; column < 3; column++) {
+        my::ParticleStore alone;
+        my::ParticleContactArena contacts(64);
+        buildPiles(alone, contacts, column);
+        my::ParticleContactResolver single(2 * contacts.size(), my::ParticleContactResolver::PRIORITY_QUEUE);
+        single.resolveContacts(contacts.data(), contacts.size(), alone, 0.01f);
+        for (int i = 4 * column; i < 4 * column + 4; i++) {
+            my::Vector3 p0 = all.positions().get(i + 1), p1 = alone.positions().get(i + 1);
+            my::Vector3 v0 = all.velocities().get(i + 1), v1 = alone.velocities().get(i + 1);
+            if (p0.x != p1.x || p0.y != p1.y || v0.x != v1.x || v0.y != v1.y) {
+                std::printf("island %d differs from resolving its pile alone\n", column);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Builds satellites sitting on one movable hub, each satellite with a
+ * contact to the hub, so every one of those contacts needs a colour of
+ * its own, plus independent particles each with a ground contact,
+ * which all share the first colour. Everything approaches along the
+ * normal. Each contact only pushes the hub further down, so once
+ * resolved it stays resolved.
+ */
+static unsigned buildStar(my::ParticleStore &store, my::ParticleContactArena &contacts, unsigned satellites, unsigned grounded)
+{
+    my::Particle particle;
+    particle.setMass(4.0f);
+    particle.setVelocity(0, 1, 0);
+    my::ParticleHandle hub = store.add(particle);
+    for (unsigned i = 0; i < satellites + grounded; i++) {
+        particle.setPosition(my::real(i), 1, 0);
+        particle.setVelocity(0, -1.0f - my::real(i % 5), 0);
+        particle.setMass(1.0f + i % 3);
+        my::ParticleHandle handle = store.add(particle);
+
+        my::ParticleContact *contact = contacts.allocate();
+        contact->particle[0] = handle;
+        contact->particle[1] = i < satellites ? hub : my::NO_PARTICLE;
+        contact->contactNormal = my::UP;
+        contact->penetration = 0.01f * (1 + i % 4);
+        contact->restitution = 0.25f * (i % 3);
+    }
+    return contacts.size();
+}
+
+static int colorsResolveContacts(my::ParticleContactResolver &resolver, const char *name)
+{
+    const unsigned satellites = my::ParticleContactResolver::MAX_COLORS + 6, grounded = 1000;
+    my::ParticleStore store;
+    my::ParticleContactArena contacts(satellites + grounded);
+    unsigned count = buildStar(store, contacts, satellites, grounded);
+
+    // The contacts are resolved in place, so keep the geometry.
+    std::vector<my::real> before(count);
+    for (unsigned i = 0; i < count; i++) {
+        const my::ParticleContact &contact = contacts[i];
+        before[i] = store.getPosition(contact.particle[0]) * contact.contactNormal;
+        if (contact.particle[1] != my::NO_PARTICLE) before[i] -= store.getPosition(contact.particle[1]) * contact.contactNormal;
+    }
+
+    resolver.setIterations(2 * count);
+    resolver.resolveContacts(contacts.data(), count, store, 0.01f);
+
+    int failures = 0;
+    for (unsigned i = 0; i < count; i++) {
+        const my::ParticleContact &contact = contacts[i];
+        my::Vector3 relativeVelocity = store.getVelocity(contact.particle[0]);
+        my::real separation = store.getPosition(contact.particle[0]) * contact.contactNormal;
+        if (contact.particle[1] != my::NO_PARTICLE) {
+            relativeVelocity -= store.getVelocity(contact.particle[1]);
+            separation -= store.getPosition(contact.particle[1]) * contact.contactNormal;
+        }
+        my::real separatingVelocity = relativeVelocity * contact.contactNormal;
+        if (separatingVelocity < -1e-5f || separation - before[i] < contact.penetration - 1e-5f) {
+            std::printf("%s resolver left contact %u with separating velocity %f and moved it apart by %f of %f\n",
+                        name, i, separatingVelocity, separation - before[i], contact.penetration);
+            if (++failures > 4) break;
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    my::ParticleContactResolver scan(1200, my::ParticleContactResolver::LINEAR_SCAN);
+    my::ParticleContactResolver heap(1200, my::ParticleContactResolver::PRIORITY_QUEUE);
+    if (!resolveAndCompare(scan, heap)) return 1;
+
+    my::ParticleContactResolver serial(1200, my::ParticleContactResolver::GRAPH_COLORED);
+    my::ParticleContactResolver parallel(1200, my::ParticleContactResolver::GRAPH_COLORED);
+    parallel.setThreadPool(std::make_shared<my::ThreadPool>(4));
+    if (!resolveAndCompare(serial, parallel)) return 1;
+    if (colorsResolveContacts(serial, "serial graph-coloured")) return 1;
+    if (colorsResolveContacts(parallel, "parallel graph-coloured")) return 1;
+
+    my::ParticleContactResolver serialIslands(0);
+    my::ParticleContactResolver parallelIslands(0);
+    parallelIslands.setThreadPool(std::make_shared<my::ThreadPool>(4));
+    if (!resolveIslandsAndCompare(serialIslands, parallelIslands)) return 1;
+    if (!islandsResolveAlone()) return 1;
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include "structre/body.hpp"
+#include "structre/inertia_transform.hpp"
+#include "structre/rigid_body_store.hpp"
+#include "structre/rigid_body_world.hpp"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <my.h>
+#include <vector>
+
+/**
+ * Checks that a spinning rigid body turns by the expected angle, that
+ * its world-space inverse inertia tensor is the body tensor rotated
+ * into the world, and that a RigidBodyWorld stepping many bodies in
+ * one batched pass matches integrating each RigidBody on its own,
+ * with the inertia tensors transformed by any of the SIMD paths.
+ */
+static bool near(my::real a, my::real b, my::real tolerance)
+{
+    return std::fabs(a - b) <= tolerance;
+}
+
+static bool matricesNear(const my::Matrix3 &a, const my::Matrix3 &b, my::real tolerance)
+{
+    for (unsigned k = 0; k < 9; k++) {
+        if (!near(a.data[k], b.data[k], tolerance)) return false;
+    }
+    return true;
+}
+
+static my::RigidBody makeBox(unsigned i)
+{
+    my::RigidBody body;
+    body.setMass(1 + my::real(i % 5));
+    body.setDamping(0.95f, 0.8f);
+    my::Matrix3 inertia;
+    inertia.setBlockInertiaTensor(my::Vector3(0.5f + 0.1f * (i % 3), 0.5f, 0.3f + 0.05f * (i % 7)), body.getMass());
+    body.setInertiaTensor(inertia);
+    body.setPosition(my::real(i), 2, -my::real(i % 4));
+    body.setVelocity(0, 1, 0.1f * my::real(i % 3));
+    body.setRotation(my::Vector3(0.3f * my::real(i % 4), 1, -0.5f));
+    body.setOrientation(my::Quaternion(1, 0.1f * my::real(i % 5), 0.2f, -0.1f));
+    body.setAcceleration(0, -9.81f, 0);
+    body.calculateDerivedData();
+    return body;
+}
+
+static int testSpin()
+{
+    int failures = 0;
+    const my::real pi = 3.14159265f;
+
+    my::RigidBody body;
+    body.setMass(2);
+    body.setDamping(1, 1);
+    my::Matrix3 inertia;
+    inertia.setDiagonal(1, 2, 3);
+    body.setInertiaTensor(inertia);
+    body.setRotation(my::Vector3(0, 0, pi));
+    body.calculateDerivedData();
+
+    for (unsigned step = 0; step < 120; step++) body.integrate(1.0f / 240);
+
+    // Half a second at pi radians per second is a quarter turn about z.
+    my::Vector3 x = body.getPointInWorldSpace(my::X);
+    if (!near(x.x, 0, 0.01f) || !near(x.y, 1, 0.01f) || !near(x.z, 0, 0.01f)) {
+        std::printf("spun x axis is (%f, %f, %f), expected (0, 1, 0)\n", x.x, x.y, x.z);
+        failures++;
+    }
+
+    my::Matrix4 transform = body.getTransform();
+    my::Matrix3 rotation(transform.data[0], transform.data[1], transform.data[2],
+        transform.data[4], transform.data[5], transform.data[6],
+        transform.data[8], transform.data[9], transform.data[10]);
+    my::Matrix3 expected = rotation * body.getInverseInertiaTensor() * rotation.transpose();
+    if (!matricesNear(body.getInverseInertiaTensorWorld(), expected, 1e-5f)) {
+        std::printf("world inverse inertia tensor is not R * I^-1 * R^T\n");
+        failures++;
+    }
+
+    // A torque about z on the tensor's z axis gives torque / Izz.
+    body.setRotation(my::Vector3());
+    body.setOrientation(my::Quaternion());
+    body.calculateDerivedData();
+    body.addTorque(my::Vector3(0, 0, 3));
+    body.integrate(0.5f);
+    if (!near(body.getRotation().z, 0.5f, 1e-5f)) {
+        std::printf("torque gave rotation %f, expected 0.5\n", body.getRotation().z);
+        failures++;
+    }
+    return failures;
+}
+
+static int testBatchMatchesBodies()
+{
+    int failures = 0;
+    const unsigned count = 101;
+
+    my::RigidBodyWorld world;
+    std::vector<my::RigidBody> reference;
+    std::vector<my::RigidBodyHandle> handles;
+    for (unsigned i = 0; i < count; i++) {
+        reference.push_back(makeBox(i));
+        handles.push_back(world.addBody(reference.back()));
+    }
+    auto gravity = std::make_shared<my::RigidBodyGravity>(my::Vector3(0, -2, 0));
+    for (auto handle : handles) world.getForceRegistry()->addRegistration(handle, gravity);
+
+    auto store = world.getBodies();
+    for (unsigned step = 0; step < 30; step++) {
+        world.startFrame();
+        for (unsigned i = 0; i < count; i++) {
+            my::Vector3 force(0.5f, 0, my::real(i % 3) - 1);
+            my::Vector3 point = reference[i].getPosition() + my::Vector3(0.1f, 0.2f, 0);
+            reference[i].addForce(my::Vector3(0, -2, 0) * reference[i].getMass());
+            reference[i].addForceAtPoint(force, point);
+            store->addForceAtPoint(handles[i], force, point);
+        }
+        world.runPhysics(1.0f / 60);
+        for (auto &body : reference) body.integrate(1.0f / 60);
+    }
+
+    unsigned mismatched = 0;
+    for (unsigned i = 0; i < count; i++) {
+        my::RigidBody body = store->get(handles[i]);
+        my::Vector3 p = body.getPosition(), q = reference[i].getPosition();
+        my::Quaternion o = body.getOrientation(), r = reference[i].getOrientation();
+        bool same = near(p.x, q.x, 1e-4f) && near(p.y, q.y, 1e-4f) && near(p.z, q.z, 1e-4f);
+        for (unsigned k = 0; k < 4; k++) same = same && near(o.data[k], r.data[k], 1e-4f);
+        same = same && matricesNear(store->getInverseInertiaTensorWorld(handles[i]), reference[i].getInverseInertiaTensorWorld(), 1e-4f);
+        for (unsigned k = 0; k < 12; k++) same = same && near(store->getTransform(handles[i]).data[k], reference[i].getTransform().data[k], 1e-4f);
+        if (!same) mismatched++;
+    }
+    if (mismatched) {
+        std::printf("%u of %u batched bodies differ from integrating each body\n", mismatched, count);
+        failures++;
+    }
+    return failures;
+}
+
+static int testStore()
+{
+    int failures = 0;
+
+    my::RigidBodyStore store;
+    std::vector<my::RigidBodyHandle> handles;
+    for (unsigned i = 0; i < 8; i++) handles.push_back(store.add(makeBox(i)));
+
+    store.setAwake(handles[2], false);
+    store.setAwake(handles[5], false);
+    store.remove(handles[3]);
+    if (store.getAwakeCount() != 5 || store.size() != 7) {
+        std::printf("store holds %u awake of %u bodies, expected 5 of 7\n", (unsigned)store.getAwakeCount(), (unsigned)store.size());
+        failures++;
+    }
+
+    unsigned wrong = 0;
+    for (unsigned i = 0; i < 8; i++) {
+        if (i == 3) continue;
+        my::RigidBody expected = makeBox(i);
+        my::RigidBody body = store.get(handles[i]);
+        bool asleep = (i == 2 || i == 5);
+        if (store.isAwake(handles[i]) == asleep || body.getAwake() == asleep) wrong++;
+        if (body.getPosition().x != expected.getPosition().x) wrong++;
+        if (!matricesNear(body.getInverseInertiaTensorWorld(), expected.getInverseInertiaTensorWorld(), 1e-6f)) wrong++;
+        if (asleep && store.getRotation(handles[i]).y != 0) wrong++;
+    }
+    if (wrong) {
+        std::printf("%u wrong values after sleeping and removing bodies\n", wrong);
+        failures++;
+    }
+
+    // A sleeping body keeps still while the others move, until a
+    // force wakes it.
+    my::Vector3 before = store.getPosition(handles[2]);
+    store.integrate(0.1f);
+    my::Vector3 after = store.getPosition(handles[2]);
+    if (before.x != after.x || before.y != after.y || before.z != after.z) {
+        std::printf("sleeping body moved\n");
+        failures++;
+    }
+    store.addForce(handles[2], my::Vector3(1, 0, 0));
+    if (!store.isAwake(handles[2])) {
+        std::printf("force did not wake the body\n");
+        failures++;
+    }
+    return failures;
+}
+
+static int testInertiaModes()
+{
+    int failures = 0;
+
+    // An odd count leaves bodies over after the last whole batch.
+    my::RigidBodyStore store;
+    for (unsigned i = 0; i < 37; i++) store.add(makeBox(i));
+    store.transformInertiaTensors(0, store.size());
+    const my::Matrix3Array expected = store.inverseInertiaTensorsWorld();
+
+    const my::InertiaTensorTransform::Mode modes[] = {
+        my::InertiaTensorTransform::SSE,
+        my::InertiaTensorTransform::AVX
+    };
+    for (auto mode : modes) {
+        if (!my::InertiaTensorTransform::supports(mode)) continue;
+        for (auto &component : store.inverseInertiaTensorsWorld().c) component.assign(component.size(), 0);
+
+        my::InertiaTensorTransform transform(mode);
+        transform.transform(store, 3, store.size());
+        for (unsigned i = 0; i < store.size(); i++) {
+            my::Matrix3 got = store.inverseInertiaTensorsWorld().get(i);
+            my::Matrix3 want = i < 3 ? my::Matrix3() : expected.get(i);
+            if (!matricesNear(got, want, 1e-6f)) {
+                std::printf("mode %d differs at body %u\n", (int)mode, i);
+                failures++;
+                break;
+            }
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    return testSpin() + testBatchMatchesBodies() + testStore() + testInertiaModes();
+}
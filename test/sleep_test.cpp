@@ -0,0 +1,249 @@
+#include "structre/body.hpp"
+#include "structre/particle_collision.hpp"
+#include "structre/particle_pairwise.hpp"
+#include "structre/particle_spring.hpp"
+#include "structre/particle_world.hpp"
+#include <cstdio>
+#include <memory>
+#include <my.h>
+
+/**
+ * Checks that particles resting on the ground fall asleep and stop
+ * moving, that an awake particle landing on them wakes only the ones
+ * it touches, that sleeping particles keep the awake ones in front
+ * of the store through adds and removes, that springs and force
+ * generators wake the sleeping particles they push, and only those
+ * registered with them, without moving particles during the force
+ * pass, and that rigid bodies sleep and are woken by forces.
+ */
+static bool storeKeepsAwakeInFront(const my::ParticleStore &store)
+{
+    for (unsigned i = 0; i < store.size(); i++) {
+        if (store.indexOf(store.handleAt(i)) != i) return false;
+        if ((i < store.getAwakeCount()) != store.isAwake(store.handleAt(i))) return false;
+    }
+    return true;
+}
+
+static int testParticles()
+{
+    int failures = 0;
+
+    my::ParticleWorld world(256);
+    world.setSleepThreshold(0.3f);
+    std::vector<my::ParticleHandle> handles;
+    for (unsigned i = 0; i < 10; i++) {
+        my::Particle particle;
+        particle.setMass(1);
+        particle.setDamping(0.9f);
+        particle.setAcceleration(my::GRAVITY);
+        particle.setPosition(my::real(i) * 2, 0.5f, 0);
+        handles.push_back(world.addParticle(particle));
+    }
+    auto ground = std::make_shared<my::GroundContacts>();
+    ground->init(handles);
+    world.getContactGenerators()->push_back(ground);
+    world.getContactGenerators()->push_back(std::make_shared<my::ParticleCollisionGenerator>(0.5f));
+
+    auto store = world.getParticles();
+    for (unsigned step = 0; step < 600; step++) {
+        world.startFrame();
+        world.runPhysics(1.0f / 60);
+    }
+    if (store->getAwakeCount() != 0) {
+        std::printf("%u resting particles are still awake\n", (unsigned)store->getAwakeCount());
+        failures++;
+    }
+
+    my::Vector3 rested = store->getPosition(handles[3]);
+    for (unsigned step = 0; step < 60; step++) {
+        world.startFrame();
+        world.runPhysics(1.0f / 60);
+    }
+    my::Vector3 still = store->getPosition(handles[3]);
+    if (rested.x != still.x || rested.y != still.y || rested.z != still.z) {
+        std::printf("a sleeping particle moved\n");
+        failures++;
+    }
+
+    my::Particle falling;
+    falling.setMass(1);
+    falling.setDamping(0.9f);
+    falling.setAcceleration(my::GRAVITY);
+    falling.setPosition(6.2f, 3, 0);
+    my::ParticleHandle dropped = world.addParticle(falling);
+    for (unsigned step = 0; step < 40; step++) {
+        world.startFrame();
+        world.runPhysics(1.0f / 60);
+    }
+    if (!store->isAwake(handles[3]) || store->isAwake(handles[0]) || store->isAwake(handles[9])) {
+        std::printf("landing woke the wrong particles\n");
+        failures++;
+    }
+
+    store->remove(dropped);
+    store->remove(handles[0]);
+    store->addForce(handles[9], my::Vector3(1, 0, 0));
+    if (!store->isAwake(handles[9]) || !storeKeepsAwakeInFront(*store)) {
+        std::printf("store lost track of awake particles\n");
+        failures++;
+    }
+    return failures;
+}
+
+/**
+ * Pushes another particle from the particle it is registered on, and
+ * records whether the store's layout changed while it did.
+ */
+struct Nudge : public my::ParticleForceGenerator {
+    my::ParticleHandle target;
+    bool layoutChanged = false;
+
+    Nudge(my::ParticleHandle target) : target(target) {}
+
+    void updateForce(my::ParticleStore &particles, my::ParticleHandle particle, my::real duration) override
+    {
+        unsigned version = particles.getLayoutVersion();
+        particles.addForce(target, my::Vector3(0, 1, 0));
+        layoutChanged = layoutChanged || particles.getLayoutVersion() != version;
+    }
+};
+
+static int testForcesWake()
+{
+    int failures = 0;
+
+    my::ParticleWorld world(16);
+    world.setSleepThreshold(0.3f);
+    my::Particle particle;
+    particle.setMass(1);
+    particle.setDamping(0.9f);
+    my::ParticleHandle awake = world.addParticle(particle);
+    particle.setPosition(2, 0, 0);
+    my::ParticleHandle pulled = world.addParticle(particle);
+    particle.setPosition(0, 5, 0);
+    my::ParticleHandle nudged = world.addParticle(particle);
+
+    auto network = std::make_shared<my::SpringNetwork>();
+    network->addSpring(awake, pulled, 10, 1);
+    auto nudge = std::make_shared<Nudge>(nudged);
+    world.getForceRegistry()->addRegistration(awake, network);
+    world.getForceRegistry()->addRegistration(pulled, network);
+    world.getForceRegistry()->addRegistration(awake, nudge);
+
+    auto store = world.getParticles();
+    // Waking the nudged particle would swap it with the pulled one.
+    store->setAwake(nudged, false);
+    store->setAwake(pulled, false);
+    world.startFrame();
+    world.runPhysics(1.0f / 60);
+
+    // The stretched spring pulls its sleeping end towards the awake one.
+    if (!store->isAwake(pulled) || !(store->getVelocity(pulled).x < 0)) {
+        std::printf("spring to an awake particle left its sleeping end still\n");
+        failures++;
+    }
+    if (!store->isAwake(nudged) || !(store->getVelocity(nudged).y > 0)) {
+        std::printf("force from a generator did not wake the particle it pushed\n");
+        failures++;
+    }
+    if (nudge->layoutChanged || !storeKeepsAwakeInFront(*store)) {
+        std::printf("waking moved particles during the force pass\n");
+        failures++;
+    }
+    return failures;
+}
+
+static int testUnregisteredStayAsleep()
+{
+    int failures = 0;
+
+    my::ParticleWorld world(16);
+    world.setSleepThreshold(0.3f);
+    my::Particle particle;
+    particle.setMass(1);
+    particle.setDamping(0.9f);
+    my::ParticleHandle awake = world.addParticle(particle);
+    particle.setPosition(0.8f, 0, 0);
+    my::ParticleHandle pulled = world.addParticle(particle);
+    particle.setPosition(0, 0.8f, 0);
+    my::ParticleHandle loose = world.addParticle(particle);
+
+    // Both generators push loose, but neither has it registered.
+    my::CohesionKernel kernel;
+    kernel.minNaturalDistance = 0.3f;
+    kernel.maxNaturalDistance = 0.5f;
+    kernel.maxDistance = 1;
+    kernel.maxRepulsion = 10;
+    kernel.maxAttraction = 20;
+    auto cohesion = std::make_shared<my::PairwiseForceGenerator<my::CohesionKernel>>(kernel.maxDistance, 0.2f, kernel);
+    auto network = std::make_shared<my::SpringNetwork>();
+    network->addSpring(awake, loose, 10, 0.2f);
+    world.getForceRegistry()->addRegistration(awake, cohesion);
+    world.getForceRegistry()->addRegistration(pulled, cohesion);
+    world.getForceRegistry()->addRegistration(awake, network);
+
+    auto store = world.getParticles();
+    store->setAwake(pulled, false);
+    store->setAwake(loose, false);
+    world.startFrame();
+    world.runPhysics(1.0f / 60);
+
+    if (!store->isAwake(pulled)) {
+        std::printf("cohesion to an awake particle left its sleeping neighbour asleep\n");
+        failures++;
+    }
+    if (store->isAwake(loose)) {
+        std::printf("generators woke a particle not registered with them\n");
+        failures++;
+    }
+    return failures;
+}
+
+static int testRigidBodies()
+{
+    int failures = 0;
+
+    my::RigidBody body;
+    body.setMass(2);
+    body.setDamping(0.5f, 0.5f);
+    body.setVelocity(0, 0, 0);
+    const my::real threshold = 0.3f;
+    for (unsigned step = 0; step < 600 && body.getAwake(); step++) {
+        body.integrate(1.0f / 60);
+        body.updateMotion(1.0f / 60, threshold);
+    }
+    if (body.getAwake()) {
+        std::printf("resting body did not fall asleep\n");
+        failures++;
+    }
+
+    body.integrate(1.0f / 60);
+    body.addForce(my::Vector3(0, 10, 0));
+    if (!body.getAwake()) {
+        std::printf("force did not wake the body\n");
+        failures++;
+    }
+    body.integrate(1.0f / 60);
+    if (body.getVelocity().y <= 0) {
+        std::printf("woken body did not move\n");
+        failures++;
+    }
+
+    body.setCanSleep(false);
+    body.setVelocity(0, 0, 0);
+    for (unsigned step = 0; step < 600; step++) {
+        body.integrate(1.0f / 60);
+        body.updateMotion(1.0f / 60, threshold);
+    }
+    if (!body.getAwake()) {
+        std::printf("body that cannot sleep fell asleep\n");
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    return testParticles() + testForcesWake() + testUnregisteredStayAsleep() + testRigidBodies();
+}
@@ -0,0 +1,161 @@
+#include "structre/particle_force.hpp"
+#include "structre/particle_spring.hpp"
+#include "structre/particle_store.hpp"
+#include "structre/thread_pool.hpp"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <my.h>
+#include <vector>
+
+/**
+ * Checks that a SpringNetwork applies the same forces as a
+ * ParticleSpring at each end of every spring, that its forces sum to
+ * zero, that it gives the same result on a thread pool, that it skips
+ * springs outside their length range, and that it follows particles
+ * moved by a removal.
+ */
+struct Sheet {
+    my::ParticleStore store;
+    std::vector<my::ParticleHandle> handles;
+    std::vector<unsigned> a, b;
+};
+
+static void buildSheet(Sheet &sheet, unsigned side)
+{
+    for (unsigned i = 0; i < side * side; i++) {
+        my::Particle particle;
+        // Jitter the grid so that every spring is stretched or squashed.
+        particle.setPosition(my::real(i % side) * 1.1f, my::real(i / side) * 0.9f, my::real(i % 7) * 0.05f);
+        particle.setMass(1);
+        particle.setDamping(0.99f);
+        sheet.handles.push_back(sheet.store.add(particle));
+    }
+    for (unsigned i = 0; i < side * side; i++) {
+        if (i % side + 1 < side) { sheet.a.push_back(i); sheet.b.push_back(i + 1); }
+        if (i + side < side * side) { sheet.a.push_back(i); sheet.b.push_back(i + side); }
+        if (i % side + 1 < side && i + side < side * side) { sheet.a.push_back(i); sheet.b.push_back(i + side + 1); }
+    }
+}
+
+static std::shared_ptr<my::SpringNetwork> buildNetwork(const Sheet &sheet)
+{
+    auto network = std::make_shared<my::SpringNetwork>();
+    for (unsigned s = 0; s < sheet.a.size(); s++) {
+        network->addSpring(sheet.handles[sheet.a[s]], sheet.handles[sheet.b[s]], 20, 1);
+    }
+    return network;
+}
+
+static void applyNetwork(Sheet &sheet, std::shared_ptr<my::SpringNetwork> network)
+{
+    my::ParticleForceRegistry registry;
+    for (auto handle : sheet.handles) registry.addRegistration(handle, network);
+    sheet.store.clearAccumulators();
+    registry.updateForces(sheet.store, 0.01f);
+}
+
+static int testMatchesSprings()
+{
+    int failures = 0;
+
+    Sheet springs, network;
+    buildSheet(springs, 8);
+    buildSheet(network, 8);
+
+    my::ParticleForceRegistry registry;
+    for (unsigned s = 0; s < springs.a.size(); s++) {
+        auto a = springs.handles[springs.a[s]], b = springs.handles[springs.b[s]];
+        registry.addRegistration(a, std::make_shared<my::ParticleSpring>(b, 20, 1));
+        registry.addRegistration(b, std::make_shared<my::ParticleSpring>(a, 20, 1));
+    }
+    springs.store.clearAccumulators();
+    registry.updateForces(springs.store, 0.01f);
+    applyNetwork(network, buildNetwork(network));
+
+    my::Vector3 total;
+    for (unsigned i = 0; i < network.handles.size(); i++) {
+        my::Vector3 expected = springs.store.forceAccums().get(springs.store.indexOf(springs.handles[i]));
+        my::Vector3 actual = network.store.forceAccums().get(network.store.indexOf(network.handles[i]));
+        total += actual;
+        if ((expected - actual).magnitude() > 1e-4f) {
+            std::printf("particle %u gets (%f, %f, %f) from the network and (%f, %f, %f) from springs\n", i,
+                        actual.x, actual.y, actual.z, expected.x, expected.y, expected.z);
+            failures++;
+        }
+    }
+    if (total.magnitude() > 1e-3f) {
+        std::printf("network forces sum to %f, expected zero\n", total.magnitude());
+        failures++;
+    }
+    return failures;
+}
+
+static int testThreadPool()
+{
+    int failures = 0;
+
+    Sheet serial, parallel;
+    buildSheet(serial, 40);
+    buildSheet(parallel, 40);
+    applyNetwork(serial, buildNetwork(serial));
+    auto network = buildNetwork(parallel);
+    network->setThreadPool(std::make_shared<my::ThreadPool>(4), 256);
+    applyNetwork(parallel, network);
+
+    for (unsigned i = 0; i < serial.handles.size(); i++) {
+        my::Vector3 expected = serial.store.forceAccums().get(i);
+        my::Vector3 actual = parallel.store.forceAccums().get(i);
+        if (expected.x != actual.x || expected.y != actual.y || expected.z != actual.z) {
+            std::printf("particle %u gets a different force on the thread pool\n", i);
+            failures++;
+            break;
+        }
+    }
+    return failures;
+}
+
+static int testRangeAndRemoval()
+{
+    int failures = 0;
+
+    my::ParticleStore store;
+    my::Particle particle;
+    particle.setMass(1);
+    particle.setDamping(0.99f);
+    auto spare = store.add(particle);
+    auto a = store.add(particle);
+    particle.setPosition(3, 0, 0);
+    auto b = store.add(particle);
+
+    auto network = std::make_shared<my::SpringNetwork>();
+    network->addSpring(a, b, 2, 1, 0, 2.5f);
+    my::ParticleForceRegistry registry;
+    registry.addRegistration(a, network);
+    registry.addRegistration(b, network);
+
+    // Longer than the spring's maximum length: no force.
+    store.clearAccumulators();
+    registry.updateForces(store, 0.01f);
+    if (store.forceAccums().get(store.indexOf(a)).magnitude() != 0) {
+        std::printf("spring beyond its maximum length applied a force\n");
+        failures++;
+    }
+
+    // Removing the first particle moves the others to new slots.
+    store.remove(spare);
+    store.setPosition(b, 0, 2, 0);
+    store.clearAccumulators();
+    registry.updateForces(store, 0.01f);
+    my::Vector3 force = store.forceAccums().get(store.indexOf(a));
+    if (std::fabs(force.y - 2) > 1e-5f || force.x != 0) {
+        std::printf("spring applied (%f, %f, %f) after a removal, expected (0, 2, 0)\n", force.x, force.y, force.z);
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    return testMatchesSprings() + testThreadPool() + testRangeAndRemoval();
+}
@@ -1,4 +1,4 @@
-#include "structre/particle.h"
+#include "structre/particle.hpp"
 #include <iostream>
 #include <my.h>
 
@@ -0,0 +1,79 @@
+#include "structre/fixed_timestep.hpp"
+#include <cstdio>
+#include <my.h>
+
+/**
+ * Checks that frames are split into whole fixed steps with the rest
+ * carried over, that slow frames are capped, and that interpolated
+ * positions blend between the recorded and current positions.
+ */
+static bool near(my::real a, my::real b)
+{
+    return a - b < 1e-4f && b - a < 1e-4f;
+}
+
+int main()
+{
+    int failures = 0;
+
+    my::FixedTimestep timestep(0.01f, 4);
+    unsigned total = 0;
+    auto count = [&total](my::real){ total++; };
+
+    if (timestep.advance(0.025f, count) != 2 || !near(timestep.getAlpha(), 0.5f)){
+        std::printf("expected 2 steps and alpha 0.5, got %u and %f\n", total, timestep.getAlpha());
+        failures++;
+    }
+    if (timestep.advance(0.005f, count) != 1 || !near(timestep.getAlpha(), 0)){
+        std::printf("carried time did not make up a step, alpha %f\n", timestep.getAlpha());
+        failures++;
+    }
+
+    total = 0;
+    unsigned steps = timestep.advance(1.0f, count);
+    if (steps != 4 || total != 4){
+        std::printf("slow frame took %u steps, expected the cap of 4\n", steps);
+        failures++;
+    }
+    if (timestep.getAlpha() < 0 || timestep.getAlpha() >= 1 || !near(timestep.getDroppedTime(), 0.96f)){
+        std::printf("slow frame left alpha %f and dropped %f\n", timestep.getAlpha(), timestep.getDroppedTime());
+        failures++;
+    }
+    if (timestep.advance(0.001f, count) != 0){
+        std::printf("dropped time was carried into the next frame\n");
+        failures++;
+    }
+
+    my::ParticleStore store;
+    my::Particle particle;
+    particle.setMass(1);
+    particle.setPosition(my::Vector3(0, 0, 0));
+    my::ParticleHandle a = store.add(particle);
+    particle.setPosition(my::Vector3(1, 1, 1));
+    my::ParticleHandle b = store.add(particle);
+
+    my::PositionHistory history;
+    history.record(store);
+    store.setPosition(a, my::Vector3(2, 4, 6));
+
+    my::Vector3 half = history.interpolate(store, a, 0.5f);
+    if (!near(half.x, 1) || !near(half.y, 2) || !near(half.z, 3)){
+        std::printf("interpolated (%f %f %f), expected (1 2 3)\n", half.x, half.y, half.z);
+        failures++;
+    }
+    my::Vector3Array all;
+    history.interpolate(store, 0.25f, all);
+    if (!near(all.get(0).y, 1) || !near(all.get(store.indexOf(b)).x, 1)){
+        std::printf("bulk interpolation disagrees with single interpolation\n");
+        failures++;
+    }
+
+    store.remove(b);
+    my::Vector3 current = history.interpolate(store, a, 0.5f);
+    if (!near(current.y, 4)){
+        std::printf("stale history was used after the store changed\n");
+        failures++;
+    }
+
+    return failures;
+}
@@ -0,0 +1,75 @@
+#include "structre/particle_world.hpp"
+#include "structre/trace_recorder.hpp"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <my.h>
+#include <string>
+
+/**
+ * Checks that a traced world step records its phases and generators
+ * by readable name, that pool workers get their own tracks, and that
+ * a full ring keeps only the latest spans.
+ */
+static std::string writeTrace(const my::TraceRecorder &recorder)
+{
+    std::FILE *file = std::tmpfile();
+    recorder.write(file);
+    std::string text;
+    std::rewind(file);
+    char buffer[4096];
+    std::size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, read);
+    std::fclose(file);
+    return text;
+}
+
+static unsigned countOf(const std::string &text, const char *pattern)
+{
+    unsigned count = 0;
+    for (std::size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) count++;
+    return count;
+}
+
+int main()
+{
+    int failures = 0;
+
+    auto recorder = std::make_shared<my::TraceRecorder>(1024);
+    my::ParticleWorld world(16);
+    auto gravity = std::make_shared<my::ParticleGravity>(my::GRAVITY);
+    for (unsigned i = 0; i < 4; i++) {
+        my::Particle particle;
+        particle.setMass(1);
+        world.getForceRegistry()->addRegistration(world.addParticle(particle), gravity);
+    }
+    world.setTraceRecorder(recorder);
+    world.startFrame();
+    world.runPhysics(0.01f);
+
+    std::string trace = writeTrace(*recorder);
+    if (trace.compare(0, 1, "{") != 0 || countOf(trace, "\"name\":\"runPhysics\"") != 1 ||
+        countOf(trace, "\"name\":\"integrate\"") != 1 || countOf(trace, "\"name\":\"my::ParticleGravity\"") != 2) {
+        std::printf("step trace is missing spans:\n%s\n", trace.c_str());
+        failures++;
+    }
+
+    my::ThreadPool pool(3);
+    pool.setTraceRecorder(recorder.get());
+    pool.parallelFor(64, [](unsigned, unsigned){}, 1);
+    trace = writeTrace(*recorder);
+    if (countOf(trace, "\"name\":\"parallelFor\"") != 3 || countOf(trace, "\"thread_name\"") < 3) {
+        std::printf("pool threads were not traced on their own tracks\n");
+        failures++;
+    }
+
+    my::TraceRecorder ring(4);
+    for (unsigned i = 0; i < 10; i++) ring.record(i < 6 ? "old" : "new", "test", i, i + 1);
+    trace = writeTrace(ring);
+    if (ring.getRecordedCount() != 10 || countOf(trace, "\"old\"") != 0 || countOf(trace, "\"new\"") != 4) {
+        std::printf("full ring did not keep the latest spans\n");
+        failures++;
+    }
+
+    return failures;
+}
@@ -0,0 +1,67 @@
+#include "math/base.hpp"
+#include "math/vector3a.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <my.h>
+#include <type_traits>
+
+/**
+ * Checks that Vector3A gives the same results as Vector3 for each of
+ * its operations, that its padding stays zero, and that both vector
+ * types can be copied as plain bytes.
+ */
+static bool same(const my::Vector3 &a, const my::Vector3A &b)
+{
+    const my::real tolerance = 1e-6f;
+    return std::fabs(a.x - b.x) <= tolerance && std::fabs(a.y - b.y) <= tolerance &&
+        std::fabs(a.z - b.z) <= tolerance && b.pad == 0;
+}
+
+int main()
+{
+    int failures = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            std::printf("Vector3A %s differs from Vector3\n", what);
+            failures++;
+        }
+    };
+
+    const my::Vector3 a(1.5f, -2, 0.25f), b(-0.5f, 3, 4);
+    const my::Vector3A p(1.5f, -2, 0.25f), q(-0.5f, 3, 4);
+
+    check(same(a + b, p + q), "sum");
+    check(same(a - b, p - q), "difference");
+    check(same(a * 3.0f, p * 3.0f), "scale");
+    check(same(a.componentProduct(b), p.componentProduct(q)), "component product");
+    check(same(a % b, p % q), "cross product");
+    check(std::fabs(a * b - p * q) <= 1e-6f, "dot product");
+    check(std::fabs(a.magnitude() - p.magnitude()) <= 1e-6f, "magnitude");
+
+    my::Vector3 u = a;
+    my::Vector3A v = p;
+    u.addScaledVector(b, -0.75f);
+    v.addScaledVector(q, -0.75f);
+    check(same(u, v), "addScaledVector");
+    u.normalize();
+    v.normalize();
+    check(same(u, v), "normalize");
+    u.invert();
+    v.invert();
+    check(same(u, v), "invert");
+    u -= b;
+    v -= q;
+    u *= 0.5f;
+    v *= 0.5f;
+    check(same(u, v), "in-place arithmetic");
+
+    check(std::is_trivially_copyable<my::Vector3>::value, "copy");
+    check(alignof(my::Vector3A) == 16 && sizeof(my::Vector3A) == 4 * sizeof(my::real), "layout");
+
+    my::Vector3A copied[2];
+    const my::Vector3A source[2] = {p, q};
+    std::memcpy(copied, source, sizeof(source));
+    check(same(b, copied[1]), "memcpy");
+    return failures;
+}